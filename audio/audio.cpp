@@ -0,0 +1,53 @@
+#include "audio.h"
+
+#include <algorithm>
+
+// 128 bit pattern, so the phase wraps at 128 << 16
+const uint32_t PHASE_MASK = (128u << 16) - 1;
+
+Beeper::Beeper(int sample_rate, double frequency)
+    : phase(0), step(0), gain(0), sample_rate(sample_rate) {
+  set_tone(frequency);
+}
+
+void Beeper::set_tone(double frequency) {
+  std::array<BYTE, 16> square;
+  std::fill(square.begin(), square.begin() + 8, 0xff);
+  std::fill(square.begin() + 8, square.end(), 0x00);
+  set_pattern(square, frequency * 128);
+}
+
+void Beeper::set_pattern(const std::array<BYTE, 16> &bits,
+                         double bits_per_second) {
+  pattern = bits;
+  step = (uint32_t)(bits_per_second * 65536 / sample_rate + 0.5);
+}
+
+void Beeper::render(bool gate, int16_t *out, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++) {
+    if (gate && gain < AUDIO_RAMP_SAMPLES) {
+      gain++;
+    } else if (!gate && gain > 0) {
+      gain--;
+    }
+
+    uint32_t bit_index = phase >> 16;
+    int bit = (pattern[bit_index >> 3] >> (7 - (bit_index & 7))) & 1;
+    int level = AUDIO_AMPLITUDE * gain / AUDIO_RAMP_SAMPLES;
+    out[i] = (int16_t)(bit ? level : -level);
+
+    phase = (phase + step) & PHASE_MASK;
+  }
+}
+
+AudioStream::AudioStream(AudioSink &sink, int sample_rate)
+    : beeper(sample_rate), sink(sink),
+      samples_per_frame(sample_rate / FRAMES_PER_SECOND) {}
+
+void AudioStream::frame(bool sound_on, double stretch) {
+  std::size_t count =
+      sink.frame_samples((std::size_t)(samples_per_frame * stretch + 0.5));
+  scratch.resize(count);
+  beeper.render(sound_on, scratch.data(), count);
+  sink.write(scratch.data(), count);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+const int AUDIO_SAMPLE_RATE = 44100;
+const int16_t AUDIO_AMPLITUDE = 3000;
+// ~2 ms fade in/out so starting or stopping the tone doesn't click
+const int AUDIO_RAMP_SAMPLES = 88;
+
+/**
+ * Tone generator for the sound timer.
+ * Plays a 128-bit, 1-bit-per-sample pattern in a loop, which is how XO-CHIP
+ * describes its audio buffer; a plain beep is just a pattern of 64 ones
+ * followed by 64 zeros. Everything is fixed point so output is bit exact
+ * across platforms.
+ */
+class Beeper {
+private:
+  std::array<BYTE, 16> pattern;
+  uint32_t phase; // position in the pattern, in 1/65536ths of a bit
+  uint32_t step;  // phase advance per output sample
+  int gain;       // 0 - AUDIO_RAMP_SAMPLES
+  int sample_rate;
+
+public:
+  Beeper(int sample_rate = AUDIO_SAMPLE_RATE, double frequency = 440.0);
+
+  // Square wave at the given frequency
+  void set_tone(double frequency);
+  // Arbitrary pattern, played back at bits_per_second
+  void set_pattern(const std::array<BYTE, 16> &bits, double bits_per_second);
+  // Renders count samples. The tone fades towards on or off depending on gate.
+  void render(bool gate, int16_t *out, std::size_t count);
+};
+
+/**
+ * Where generated samples go. write() must not block.
+ */
+class AudioSink {
+public:
+  virtual ~AudioSink() {}
+  virtual void write(const int16_t *samples, std::size_t count) = 0;
+  /**
+   * How many samples the sink wants for the next frame given the nominal
+   * amount. Real-time sinks nudge this up or down to keep their queue, and
+   * therefore latency, near a fixed target.
+   */
+  virtual std::size_t frame_samples(std::size_t nominal) { return nominal; }
+};
+
+// Keeps every sample, for headless runs and tests
+class NullAudioSink : public AudioSink {
+public:
+  std::vector<int16_t> samples;
+
+  void write(const int16_t *data, std::size_t count) override {
+    samples.insert(samples.end(), data, data + count);
+  }
+};
+
+/**
+ * Glue between the emulation thread and a sink: once per emulated frame,
+ * renders that frame's worth of samples with the tone gated by the sound
+ * timer.
+ */
+class AudioStream {
+private:
+  Beeper beeper;
+  AudioSink &sink;
+  std::size_t samples_per_frame;
+  std::vector<int16_t> scratch;
+
+public:
+  AudioStream(AudioSink &sink, int sample_rate = AUDIO_SAMPLE_RATE);
+
+  Beeper &tone() { return beeper; }
+  // stretch > 1 for frames that last longer than 1/60 s of wall time
+  void frame(bool sound_on, double stretch = 1.0);
+};
@@ -0,0 +1,211 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../chip/chip8.h"
+#include "../filter/phosphor.h"
+#include "../lane-engine/lane-engine.h"
+#include "../vector-env/vector-env.h"
+
+// Headless core throughput: runs each ROM flat out with no input, no
+// rendering and no pacing, ticking the timers every CYCLES_PER_FRAME cycles.
+const int CYCLES_PER_FRAME = 1000;
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void bench_core(int frames, const char *rom) {
+  CHIP8 chip = CHIP8();
+  chip.load_rom(rom);
+
+  auto start = Clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    for (int i = 0; i < CYCLES_PER_FRAME; i++) {
+      chip.cycle();
+    }
+    chip.tick_timers();
+  }
+  double seconds = seconds_since(start);
+
+  double cycles = (double)frames * CYCLES_PER_FRAME;
+  std::cout << rom << ": " << cycles / seconds / 1e6 << " MIPS, "
+            << frames / seconds << " frames/s" << std::endl;
+}
+
+// Cost per instruction of charging VIP cycles, against the plain
+// interpreter on the same loop: ADD V0, 1; JP 200, so V0 counts loops
+void bench_vip_timing(int frames) {
+  const uint8_t rom[] = {0x70, 0x01, 0x12, 0x00};
+  for (bool vip : {false, true}) {
+    CHIP8 chip;
+    chip.load_rom(rom, sizeof(rom));
+    chip.vip_timing = vip;
+    chip.cycles_per_frame = 50; // about what VIP timing fits in a frame
+    uint64_t loops = 0;
+    auto start = Clock::now();
+    for (int frame = 0; frame < frames * 100; frame++) {
+      BYTE before = chip.registers[0];
+      chip.run_frame();
+      loops += BYTE(chip.registers[0] - before);
+    }
+    double seconds = seconds_since(start);
+    std::cout << (vip ? "VIP timed: " : "plain: ")
+              << seconds * 1e9 / (loops * 2) << " ns/instruction"
+              << std::endl;
+  }
+}
+
+// DXYN in isolation for each sprite height, at aligned, unaligned and
+// clipped positions
+void bench_dxyn(int draws) {
+  CHIP8 chip = CHIP8();
+  chip.address_i = FONTSET_START_ADDRESS;
+  const struct {
+    const char *name;
+    BYTE x, y;
+  } positions[] = {
+      {"aligned", 8, 4}, {"unaligned", 13, 4}, {"clipped", 60, 20}};
+
+  for (int height = 1; height < 16; height++) {
+    std::cout << "DXYN height " << height << ":";
+    for (const auto &position : positions) {
+      chip.registers[0] = position.x;
+      chip.registers[1] = position.y;
+      chip.opcode = 0xd010 | height;
+
+      auto start = Clock::now();
+      for (int i = 0; i < draws; i++) {
+        chip.OP_DXYN();
+      }
+      double seconds = seconds_since(start);
+      std::cout << " " << position.name << " " << seconds / draws * 1e9
+                << " ns";
+    }
+    std::cout << std::endl;
+  }
+}
+
+// CXKK in isolation, the hot op in particle-heavy ROMs
+void bench_cxkk(int draws) {
+  CHIP8 chip = CHIP8();
+  chip.seed(1);
+  chip.opcode = 0xc0ff;
+
+  unsigned sum = 0;
+  auto start = Clock::now();
+  for (int i = 0; i < draws; i++) {
+    chip.OP_CXKK();
+    sum += chip.registers[0];
+  }
+  double seconds = seconds_since(start);
+  std::cout << "CXKK: " << seconds / draws * 1e9 << " ns (sum " << sum << ")"
+            << std::endl;
+}
+
+// Batched RL stepping: environment frames per second across all threads,
+// observations included
+void bench_vector_env(int steps, const char *rom_path, int threads) {
+  std::ifstream file(rom_path, std::ios::binary);
+  std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  const int envs = 1024;
+  const int frame_skip = 4;
+  VectorEnv env(rom, envs, frame_skip, threads);
+  std::vector<uint8_t> actions(envs, NO_ACTION);
+
+  auto start = Clock::now();
+  for (int step = 0; step < steps; step++) {
+    for (int i = 0; i < envs; i++) {
+      actions[i] = (i + step) % 17 < 16 ? (i + step) % 17 : NO_ACTION;
+    }
+    env.step(actions.data());
+  }
+  double seconds = seconds_since(start);
+  std::cout << "vector env " << envs << " x " << rom_path << ", "
+            << (threads ? std::to_string(threads) : std::string("all"))
+            << " threads: " << (double)steps * envs * frame_skip / seconds / 1e6
+            << "M frames/s" << std::endl;
+}
+
+// The same ROM in LANES machines, stepped one by one and as lanes; reports
+// instructions per second and how often the lanes stayed in step
+void bench_lane_engine(int frames, const char *rom) {
+  std::vector<CHIP8> machines(LANES);
+  LaneEngine lanes;
+  for (int lane = 0; lane < LANES; lane++) {
+    machines[lane].load_rom(rom);
+    machines[lane].seed(lane);
+    lanes.load(lane, machines[lane]);
+  }
+
+  auto start = Clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    for (CHIP8 &chip : machines) {
+      chip.step(CYCLES_PER_FRAME);
+      chip.tick_timers();
+    }
+  }
+  double scalar_seconds = seconds_since(start);
+
+  start = Clock::now();
+  for (int frame = 0; frame < frames; frame++) {
+    lanes.step(CYCLES_PER_FRAME);
+    lanes.tick_timers();
+  }
+  double lane_seconds = seconds_since(start);
+
+  double instructions = (double)frames * CYCLES_PER_FRAME * LANES;
+  std::cout << "lanes " << rom << ": scalar "
+            << instructions / scalar_seconds / 1e6 << "M, lanes "
+            << instructions / lane_seconds / 1e6 << "M instructions/s, "
+            << 100.0 * lanes.converged_cycles / lanes.cycles << "% converged"
+            << std::endl;
+}
+
+// Cost of the software post-process at 10x, the kiosk configuration
+void bench_phosphor(int frames, bool scale2x, bool scanlines) {
+  const int scale = 10;
+  PhosphorFilter filter(scale, 0.6, scale2x, scanlines);
+  std::vector<uint32_t> out(filter.output_width() * filter.output_height());
+
+  Frame frame{};
+  auto start = Clock::now();
+  for (int i = 0; i < frames; i++) {
+    frame[i % HEIGHT] ^= 0x0f0f0f0f0f0f0f0full << (i % 4);
+    filter.apply(frame, out.data(), filter.output_width() * sizeof(uint32_t));
+  }
+  double seconds = seconds_since(start);
+
+  std::cout << "phosphor x" << scale << (scale2x ? " scale2x" : "")
+            << (scanlines ? " scanlines" : "") << ": "
+            << seconds / frames * 1e3 << " ms/frame" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <frames> <ROM>..." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  const int frames = std::stoi(argv[1]);
+  for (int arg = 2; arg < argc; arg++) {
+    bench_core(frames, argv[arg]);
+  }
+  bench_dxyn(frames * 1000);
+  bench_cxkk(frames * 1000);
+  bench_vip_timing(frames);
+  bench_vector_env(frames / 10 + 1, argv[2], 1);
+  bench_vector_env(frames / 10 + 1, argv[2], 0);
+  for (int arg = 2; arg < argc; arg++) {
+    bench_lane_engine(frames, argv[arg]);
+  }
+  bench_phosphor(frames, false, false);
+  bench_phosphor(frames, false, true);
+  bench_phosphor(frames, true, true);
+}
@@ -1,49 +1,110 @@
 #include "chip8.h"
 #include <cassert>
 
+#include "../vip-timing/vip-timing.h"
+
+namespace {
+// splitmix64's finalizer: every input bit affects every output bit
+inline uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// A memory_hash term. Zero contributes nothing, so blank memory hashes to
+// 0 and rehash() only pays for the bytes that are set.
+inline uint64_t memory_term(std::size_t address, BYTE value) {
+  return value ? mix64(address << 8 | value) : 0;
+}
+
+constexpr VipCostTable VIP_COSTS = make_vip_cost_table();
+
+inline uint8_t vip_cost(WORD opcode) {
+  return VIP_COSTS.cost[(opcode >> 4 & 0xf00) | (opcode & 0xff)];
+}
+} // namespace
+
+const Memory &CHIP8::boot_memory() {
+  static const Memory boot = [] {
+    Memory memory;
+    memory.fill(0);
+    for (unsigned i = 0; i < FONTSET_SIZE; i++) {
+      memory[FONTSET_START_ADDRESS + i] = fontset[i];
+    }
+    return memory;
+  }();
+  return boot;
+}
+
+const std::array<CHIP8::CHIP8Func, 0xf + 1> CHIP8::table =
+    CHIP8::make_main_table();
+const std::array<CHIP8::CHIP8Func, 0xe + 1> CHIP8::table0 =
+    CHIP8::make_table0();
+const std::array<CHIP8::CHIP8Func, 0xe + 1> CHIP8::table8 =
+    CHIP8::make_table8();
+const std::array<CHIP8::CHIP8Func, 0xe + 1> CHIP8::tableE =
+    CHIP8::make_tableE();
+const std::array<CHIP8::CHIP8Func, 0x65 + 1> CHIP8::tableF =
+    CHIP8::make_tableF();
+
 void CHIP8::reset() {
-  address_i = 0;
-  program_counter = 0x200;
+  memory = boot_memory();
   std::fill(registers.begin(), registers.end(), 0);
-
-  // Reset the screen
+  address_i = 0;
+  program_counter = START_ADDRESS;
+  stack.clear();
+  delay_timer = 0;
+  sound_timer = 0;
+  opcode = 0;
+  frame_number = 0;
+  vip_budget = 0;
   reset_screen();
+  reset_keypad();
+  rehash();
 }
 
 void CHIP8::reset_screen() {
   // opcode = 0x00e0;
-  for (auto &row : screen) {
-    std::fill(row.begin(), row.end(), 0);
-  }
+  std::fill(screen.begin(), screen.end(), 0);
+}
+
+void CHIP8::write(std::size_t address, BYTE value) {
+  memory_hash ^=
+      memory_term(address, read(address)) ^ memory_term(address, value);
+  memory[address] = value;
 }
 
 void CHIP8::reset_keypad() { std::fill(keypad.begin(), keypad.end(), 0); }
 
-void CHIP8::load_rom(std::string filename) {
+bool CHIP8::load_rom(std::string filename) {
   std::ifstream file(filename, std::ios::binary | std::ios::ate);
-  int length = file.tellg();
+  if (!file) {
+    return false;
+  }
+  std::streamoff length = file.tellg();
   file.seekg(0, file.beg);
 
   std::vector<char> buffer(length);
   file.read(buffer.data(), length);
   file.close();
 
-  std::copy(buffer.begin(), buffer.end(), memory.begin() + START_ADDRESS);
+  return load_rom(reinterpret_cast<const uint8_t *>(buffer.data()),
+                  buffer.size());
 }
 
-void CHIP8::cycle() {
-  WORD ret = 0;
-  ret = memory[program_counter];
-  ret <<= 8;
-  ret |= memory[program_counter + 1];
-  program_counter += 2; // go to the next instruction
-  opcode = ret;
+bool CHIP8::load_rom(const uint8_t *data, std::size_t size) {
+  if (size > memory.size() - START_ADDRESS) {
+    return false;
+  }
+  for (std::size_t i = 0; i < size; i++) {
+    write(START_ADDRESS + i, data[i]);
+  }
+  return true;
+}
 
-  uint8_t leftmost_bit =
-      opcode >> 12; // 4 (right half of left byte) + 8 (right byte)
-  // execute the opcode
-  (this->*table[leftmost_bit])();
+void CHIP8::cycle() { execute(fetch()); }
 
+void CHIP8::tick_timers() {
   if (delay_timer > 0) {
     delay_timer--;
   }
@@ -52,6 +113,222 @@ void CHIP8::cycle() {
   }
 }
 
+void CHIP8::step(int cycles) {
+  for (int i = 0; i < cycles; i++) {
+    cycle();
+  }
+}
+
+int CHIP8::vip_variable_cost(WORD opcode) const {
+  BYTE vx = registers[(opcode >> 8) & 0xf];
+  switch (opcode >> 12) {
+  case 0xd:
+    return (opcode & 0xf) * (vx % 8 ? VIP_ROW_UNALIGNED_CYCLES
+                                    : VIP_ROW_ALIGNED_CYCLES);
+  case 0xf:
+    if ((opcode & 0xff) == 0x33) {
+      return (vx / 100 + vx / 10 % 10 + vx % 10) * VIP_BCD_DIGIT_CYCLES;
+    }
+    return (((opcode >> 8) & 0xf) + 1) * VIP_REGISTER_COPY_CYCLES;
+  default:
+    return 0; // skips, which cost more only once we know they're taken
+  }
+}
+
+int CHIP8::step_vip_frame() {
+  vip_budget += VIP_CYCLES_PER_FRAME - VIP_DISPLAY_CYCLES;
+  int ran = 0;
+  for (; vip_budget > 0; ran++) {
+    WORD next = fetch();
+    if (next >> 12 == 0xd && ran > 0) {
+      vip_budget = 0; // the rest of the frame goes on waiting
+      return ran;
+    }
+    uint8_t cost = vip_cost(next);
+    vip_budget -= VIP_FETCH_CYCLES + (cost & ~VIP_VARIABLE);
+    if (cost & VIP_VARIABLE) {
+      vip_budget -= vip_variable_cost(next);
+      WORD skipped = program_counter + 4;
+      execute(next);
+      vip_budget -= program_counter == skipped ? VIP_SKIP_CYCLES : 0;
+    } else {
+      execute(next);
+    }
+  }
+  return ran;
+}
+
+void CHIP8::run_frame() {
+#ifdef CHIP8_TRACE
+  if (trace) {
+    trace->mark_frame(frame_number);
+  }
+#endif
+  if (vip_timing) {
+    step_vip_frame();
+  } else {
+    step(cycles_per_frame);
+  }
+  tick_timers();
+  frame_number++;
+}
+
+void CHIP8::run_until(uint64_t frame) {
+  while (frame_number < frame) {
+    run_frame();
+  }
+}
+
+namespace {
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+const uint64_t FNV_PRIME = 0x100000001b3ull;
+
+inline uint64_t fnv1a(uint64_t hash, const void *data, std::size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (std::size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+} // namespace
+
+uint64_t CHIP8::fold_cpu_state(uint64_t hash) const {
+  hash = fnv1a(hash, registers.data(), registers.size());
+  hash = fnv1a(hash, &address_i, sizeof(address_i));
+  hash = fnv1a(hash, &program_counter, sizeof(program_counter));
+  // the depth matters as well as the contents
+  uint64_t depth = stack.size();
+  hash = fnv1a(hash, &depth, sizeof(depth));
+  hash = fnv1a(hash, stack.data(), stack.size() * sizeof(WORD));
+  hash = fnv1a(hash, &delay_timer, sizeof(delay_timer));
+  hash = fnv1a(hash, &sound_timer, sizeof(sound_timer));
+  return fnv1a(hash, keypad.data(), keypad.size());
+}
+
+uint64_t CHIP8::state_digest() const {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (std::size_t page = 0; page < MEMORY_PAGES; page++) {
+    hash = fnv1a(hash, memory_page(memory, page), MEMORY_PAGE_SIZE);
+  }
+  hash = fold_cpu_state(hash);
+  return fnv1a(hash, screen.data(), sizeof(screen));
+}
+
+uint64_t CHIP8::state_hash() const {
+  uint64_t hash = fold_cpu_state(FNV_OFFSET_BASIS);
+  // a word at a time: 32 multiplies, cheaper than keeping DXYN in step
+  for (uint64_t row : screen) {
+    hash = (hash ^ row) * FNV_PRIME;
+  }
+  return mix64(hash ^ memory_hash);
+}
+
+void CHIP8::rehash() {
+  memory_hash = 0;
+  for (std::size_t page = 0; page < MEMORY_PAGES; page++) {
+    const uint8_t *bytes = memory_page(memory, page);
+    for (std::size_t i = 0; i < MEMORY_PAGE_SIZE; i++) {
+      memory_hash ^= memory_term(page * MEMORY_PAGE_SIZE + i, bytes[i]);
+    }
+  }
+}
+
+namespace {
+const uint8_t STATE_VERSION = 1;
+
+template <typename T> void put(std::vector<uint8_t> &out, const T &value) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool take(const uint8_t *&data, const uint8_t *end, T &value) {
+  if (std::size_t(end - data) < sizeof(T)) {
+    return false;
+  }
+  std::copy(data, data + sizeof(T), reinterpret_cast<uint8_t *>(&value));
+  data += sizeof(T);
+  return true;
+}
+
+// Memory goes in as its bytes, whichever model holds them
+void put(std::vector<uint8_t> &out, const Memory &memory) {
+  for (std::size_t page = 0; page < MEMORY_PAGES; page++) {
+    const uint8_t *bytes = memory_page(memory, page);
+    out.insert(out.end(), bytes, bytes + MEMORY_PAGE_SIZE);
+  }
+}
+
+bool take(const uint8_t *&data, const uint8_t *end, Memory &memory) {
+  if (std::size_t(end - data) < MEMORY_SIZE) {
+    return false;
+  }
+  for (std::size_t i = 0; i < MEMORY_SIZE; i++) {
+    memory[i] = data[i];
+  }
+  data += MEMORY_SIZE;
+  return true;
+}
+} // namespace
+
+void CHIP8::save_state(std::vector<uint8_t> &out) const {
+  put(out, STATE_VERSION);
+  put(out, memory);
+  put(out, registers);
+  put(out, address_i);
+  put(out, program_counter);
+  put(out, uint16_t(stack.size()));
+  for (WORD address : stack) {
+    put(out, address);
+  }
+  put(out, delay_timer);
+  put(out, sound_timer);
+  put(out, keypad);
+  put(out, frame_number);
+  put(out, screen);
+}
+
+bool CHIP8::restore_state(const uint8_t *data, std::size_t size) {
+  const uint8_t *end = data + size;
+  uint8_t version = 0;
+  uint16_t depth = 0;
+  CHIP8 state_only; // parse into a scratch copy so failure changes nothing
+  if (!take(data, end, version) || version != STATE_VERSION ||
+      !take(data, end, state_only.memory) ||
+      !take(data, end, state_only.registers) ||
+      !take(data, end, state_only.address_i) ||
+      !take(data, end, state_only.program_counter) ||
+      !take(data, end, depth) || depth > CALL_STACK_DEPTH) {
+    return false;
+  }
+  state_only.stack.resize(depth);
+  for (WORD &address : state_only.stack) {
+    if (!take(data, end, address)) {
+      return false;
+    }
+  }
+  if (!take(data, end, state_only.delay_timer) ||
+      !take(data, end, state_only.sound_timer) ||
+      !take(data, end, state_only.keypad) ||
+      !take(data, end, state_only.frame_number) ||
+      !take(data, end, state_only.screen) || data != end) {
+    return false;
+  }
+
+  memory = state_only.memory;
+  registers = state_only.registers;
+  address_i = state_only.address_i;
+  program_counter = state_only.program_counter;
+  stack = state_only.stack;
+  delay_timer = state_only.delay_timer;
+  sound_timer = state_only.sound_timer;
+  keypad = state_only.keypad;
+  frame_number = state_only.frame_number;
+  screen = state_only.screen;
+  rehash();
+  return true;
+}
+
 void CHIP8::OP_NULL() {}
 
 void CHIP8::OP_00E0() {
@@ -129,35 +406,37 @@ void CHIP8::OP_8XY1() {
   assert(opcode & 0x8001);
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t reg_y_index = get_reg_y_index();
-  registers[reg_x_index] |= registers[reg_y_index];
+  set_logic_result(reg_x_index,
+                   registers[reg_x_index] | registers[reg_y_index]);
 }
 
 void CHIP8::OP_8XY2() {
   assert(opcode & 0x8002);
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t reg_y_index = get_reg_y_index();
-  registers[reg_x_index] &= registers[reg_y_index];
+  set_logic_result(reg_x_index,
+                   registers[reg_x_index] & registers[reg_y_index]);
 }
 
 void CHIP8::OP_8XY3() {
   assert(opcode & 0x8003);
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t reg_y_index = get_reg_y_index();
-  registers[reg_x_index] ^= registers[reg_y_index];
+  set_logic_result(reg_x_index,
+                   registers[reg_x_index] ^ registers[reg_y_index]);
 }
 
+// The arithmetic ops compute result and flag together in 9 bits and never
+// branch. For subtraction, adding 0x100 first leaves bit 8 set exactly when
+// there was no borrow.
+
 void CHIP8::OP_8XY4() {
   assert(opcode & 0x8004);
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t reg_y_index = get_reg_y_index();
 
-  uint16_t sum = registers[reg_x_index] + registers[reg_y_index];
-  if (sum > 255) {
-    registers[0xf] = 1;
-  } else {
-    registers[0xf] = 0;
-  }
-  registers[reg_x_index] = sum & 0xff; // only take the lower byte
+  unsigned sum = registers[reg_x_index] + registers[reg_y_index];
+  set_with_flag(reg_x_index, sum & 0xff, sum >> 8);
 }
 
 void CHIP8::OP_8XY5() {
@@ -165,21 +444,15 @@ void CHIP8::OP_8XY5() {
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t reg_y_index = get_reg_y_index();
 
-  uint8_t val_x = registers[reg_x_index];
-  uint8_t val_y = registers[reg_y_index];
-  if (val_x > val_y) {
-    registers[0xf] = 1;
-  } else {
-    registers[0xf] = 0;
-  }
-  registers[reg_x_index] = val_x - val_y;
+  unsigned difference =
+      0x100 + registers[reg_x_index] - registers[reg_y_index];
+  set_with_flag(reg_x_index, difference & 0xff, difference >> 8);
 }
 
 void CHIP8::OP_8XY6() {
   assert(opcode & 0x8006);
-  uint8_t reg_x_index = get_reg_x_index();
-  registers[0xf] = registers[reg_x_index] & 0x1;
-  registers[reg_x_index] >>= 1;
+  BYTE value = shift_source();
+  set_with_flag(get_reg_x_index(), value >> 1, value & 0x1);
 }
 
 void CHIP8::OP_8XY7() {
@@ -187,21 +460,15 @@ void CHIP8::OP_8XY7() {
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t reg_y_index = get_reg_y_index();
 
-  uint8_t val_x = registers[reg_x_index];
-  uint8_t val_y = registers[reg_y_index];
-  if (val_y > val_x) {
-    registers[0xf] = 1;
-  } else {
-    registers[0xf] = 0;
-  }
-  registers[reg_x_index] = (BYTE)(val_y - val_x);
+  unsigned difference =
+      0x100 + registers[reg_y_index] - registers[reg_x_index];
+  set_with_flag(reg_x_index, difference & 0xff, difference >> 8);
 }
 
 void CHIP8::OP_8XYE() {
   assert(opcode & 0x800e);
-  uint8_t reg_x_index = get_reg_x_index();
-  registers[0xf] = (registers[reg_x_index] & 0x80) >> 7; // get MSB
-  registers[reg_x_index] <<= 1;
+  BYTE value = shift_source();
+  set_with_flag(get_reg_x_index(), (BYTE)(value << 1), value >> 7); // MSB
 }
 
 void CHIP8::OP_9XY0() {
@@ -227,7 +494,32 @@ void CHIP8::OP_CXKK() {
   assert(opcode & 0xc000);
   uint8_t reg_x_index = get_reg_x_index();
   uint8_t kk = get_kk();
-  registers[reg_x_index] = rand_byte(randGen) & kk;
+  BYTE byte = random_source ? random_source->next_byte() : random.next_byte();
+  registers[reg_x_index] = byte & kk;
+}
+
+const std::array<CHIP8::DrawFunc, 32> CHIP8::draw_table =
+    CHIP8::make_draw_table(std::make_index_sequence<32>());
+
+template <int Height, bool Clipped>
+void CHIP8::draw_sprite(uint8_t x_pos, uint8_t y_pos) {
+  uint64_t collision = 0;
+
+  // Sprites are clipped at the right and bottom edges rather than wrapped
+  for (int y = 0; y < Height; y++) {
+    if (Clipped && y_pos + y >= HEIGHT) {
+      break;
+    }
+    uint64_t data = read((address_i + y) & 0xfff);
+    // place the 8 sprite bits so the MSB lands on column x_pos
+    uint64_t bits = !Clipped || x_pos <= WIDTH - 8
+                        ? data << (WIDTH - 8 - x_pos)
+                        : data >> (x_pos - (WIDTH - 8));
+    collision |= screen[y_pos + y] & bits;
+    screen[y_pos + y] ^= bits;
+  }
+
+  registers[0xf] = collision != 0;
 }
 
 void CHIP8::OP_DXYN() {
@@ -239,21 +531,8 @@ void CHIP8::OP_DXYN() {
   uint8_t x_pos = registers[reg_x_index] % WIDTH;
   uint8_t y_pos = registers[reg_y_index] % HEIGHT;
 
-  registers[0xf] = 0; // collision = false
-
-  for (int y = 0; y < height; y++) {
-    BYTE data = memory[address_i + y];
-    for (int x = 0; x < 8; x++) {
-      uint8_t sprite_pixel = data & (0b1 << (8 - x - 1));
-      uint32_t screen_pixel = screen[y_pos + y][x_pos + x];
-      if (sprite_pixel) {
-        if (screen_pixel) {
-          registers[0xf] = 1; // collision = true
-        }
-        screen[y_pos + y][x_pos + x] ^= 0xffffffff;
-      }
-    }
-  }
+  bool clipped = x_pos > WIDTH - 8 || y_pos + height > HEIGHT;
+  (this->*draw_table[height * 2 + clipped])(x_pos, y_pos);
 }
 
 void CHIP8::OP_EX9E() {
@@ -321,27 +600,29 @@ void CHIP8::OP_FX33() {
   uint8_t reg_x_index = get_reg_x_index();
   BYTE value = registers[reg_x_index];
 
-  memory[address_i + 2] = value % 10;
+  write(address_i + 2, value % 10);
   value /= 10;
 
-  memory[address_i + 1] = value % 10;
+  write(address_i + 1, value % 10);
   value /= 10;
 
-  memory[address_i] = value % 10;
+  write(address_i, value % 10);
 }
 
 void CHIP8::OP_FX55() {
   assert(opcode & 0xf055);
   uint8_t reg_x_index = get_reg_x_index();
 
-  std::copy(registers.begin(), registers.begin() + reg_x_index + 1,
-            memory.begin() + address_i);
+  for (int i = 0; i <= reg_x_index; i++) {
+    write(address_i + i, registers[i]);
+  }
 }
 
 void CHIP8::OP_FX65() {
   assert(opcode & 0xf065);
   uint8_t reg_x_index = get_reg_x_index();
 
-  std::copy(memory.begin() + address_i,
-            memory.begin() + address_i + reg_x_index + 1, registers.begin());
+  for (int i = 0; i <= reg_x_index; i++) {
+    registers[i] = read(address_i + i);
+  }
 }
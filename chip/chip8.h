@@ -1,13 +1,21 @@
+#pragma once
+
 #include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
-#include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "../paged-memory/paged-memory.h"
+#include "../rng/rng.h"
+#ifdef CHIP8_TRACE
+#include "../trace/trace-ring.h"
+#endif
+
 typedef unsigned char BYTE;
 typedef unsigned short int WORD;
 
@@ -16,6 +24,23 @@ const unsigned int FONTSET_START_ADDRESS = 0x50;
 const int WIDTH = 64;
 const int HEIGHT = 32;
 
+// Built with CHIP8_PAGED_MEMORY, instances copied from one another share
+// their memory pages until they write to them; see PagedMemory
+#ifdef CHIP8_PAGED_MEMORY
+typedef PagedMemory Memory;
+#else
+typedef std::array<BYTE, MEMORY_SIZE> Memory;
+#endif
+
+// One bit per pixel, one 64-bit word per row. Bit 63 is the leftmost pixel.
+typedef std::array<uint64_t, HEIGHT> Frame;
+
+// 60 Hz, the rate of the delay and sound timers
+const int FRAMES_PER_SECOND = 60;
+
+// ~540 Hz, close to the default 2 ms cycle delay
+const int DEFAULT_CYCLES_PER_FRAME = 9;
+
 const std::array<int, FONTSET_SIZE> fontset{
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
     0x20, 0x60, 0x20, 0x20, 0x70, // 1
@@ -37,6 +62,70 @@ const std::array<int, FONTSET_SIZE> fontset{
 
 const unsigned int START_ADDRESS = 0x200;
 
+/**
+ * Behaviours that differ between CHIP-8 interpreters. The defaults are what
+ * this emulator has always done, which matches CHIP-48/SCHIP; cosmac_vip()
+ * gives the original interpreter's behaviour.
+ * In every mode the 8XYn flag is written after the result, so with X = F the
+ * flag is what's left in VF.
+ */
+struct Quirks {
+  // 8XY6/8XYE shift Vy into Vx instead of shifting Vx in place
+  bool shift_uses_vy = false;
+  // 8XY1/8XY2/8XY3 clear VF
+  bool logic_resets_vf = false;
+
+  static Quirks cosmac_vip() {
+    Quirks quirks;
+    quirks.shift_uses_vy = true;
+    quirks.logic_resets_vf = true;
+    return quirks;
+  }
+};
+
+/**
+ * The return addresses 2NNN pushes, held in place so that copying an
+ * instance never allocates. It holds CALL_STACK_DEPTH levels, oldest
+ * first; a call beyond that drops the oldest address to make room, and a
+ * return with nothing to return to leaves the depth at 0.
+ */
+const std::size_t CALL_STACK_DEPTH = 16;
+
+class CallStack {
+private:
+  std::array<WORD, CALL_STACK_DEPTH> levels{};
+  std::size_t depth = 0; // 0 to CALL_STACK_DEPTH
+
+public:
+  inline void push_back(WORD address) {
+    if (depth == CALL_STACK_DEPTH) {
+      std::copy(levels.begin() + 1, levels.end(), levels.begin());
+      depth--;
+    }
+    levels[depth++] = address;
+  }
+  inline void pop_back() { depth -= depth > 0; }
+  // Modulo, so that an empty stack reads a stale level rather than past it
+  inline WORD back() const { return levels[(depth - 1) % CALL_STACK_DEPTH]; }
+  inline std::size_t size() const { return depth; }
+  inline bool empty() const { return depth == 0; }
+  inline void clear() { depth = 0; }
+  // New levels are zero; size is at most CALL_STACK_DEPTH
+  inline void resize(std::size_t size) {
+    for (; depth < size; depth++) {
+      levels[depth] = 0;
+    }
+    depth = size;
+  }
+  inline WORD &operator[](std::size_t level) { return levels[level]; }
+  inline WORD operator[](std::size_t level) const { return levels[level]; }
+  inline const WORD *data() const { return levels.data(); }
+  inline WORD *begin() { return levels.data(); }
+  inline WORD *end() { return levels.data() + depth; }
+  inline const WORD *begin() const { return levels.data(); }
+  inline const WORD *end() const { return levels.data() + depth; }
+};
+
 class CHIP8 {
 private:
   typedef void (CHIP8::*CHIP8Func)();
@@ -45,7 +134,8 @@ private:
    * Indexes by the unique part of the opcode
    */
   template <std::size_t Size>
-  void call_table_by_opcode(std::array<CHIP8Func, Size> &t, size_t index) {
+  void call_table_by_opcode(const std::array<CHIP8Func, Size> &t,
+                            size_t index) {
     if (index < t.size() && t[index]) {
       (this->*t[index])();
     } else {
@@ -53,8 +143,9 @@ private:
     }
   }
 
-  inline void init_main_table() {
-    std::fill(table.begin(), table.end(), &CHIP8::OP_NULL);
+  static std::array<CHIP8Func, 0xf + 1> make_main_table() {
+    std::array<CHIP8Func, 0xf + 1> table;
+    table.fill(&CHIP8::OP_NULL);
     table[0x0] = &CHIP8::Table0;
     table[0x1] = &CHIP8::OP_1NNN;
     table[0x2] = &CHIP8::OP_2NNN;
@@ -71,16 +162,20 @@ private:
     table[0xd] = &CHIP8::OP_DXYN;
     table[0xe] = &CHIP8::TableE;
     table[0xf] = &CHIP8::TableF;
+    return table;
   }
 
-  inline void init_table0() {
-    std::fill(table0.begin(), table0.end(), &CHIP8::OP_NULL);
+  static std::array<CHIP8Func, 0xe + 1> make_table0() {
+    std::array<CHIP8Func, 0xe + 1> table0;
+    table0.fill(&CHIP8::OP_NULL);
     table0[0x0] = &CHIP8::OP_00E0;
     table0[0xe] = &CHIP8::OP_00EE;
+    return table0;
   }
 
-  inline void init_table8() {
-    std::fill(table8.begin(), table8.end(), &CHIP8::OP_NULL);
+  static std::array<CHIP8Func, 0xe + 1> make_table8() {
+    std::array<CHIP8Func, 0xe + 1> table8;
+    table8.fill(&CHIP8::OP_NULL);
     table8[0x0] = &CHIP8::OP_8XY0;
     table8[0x1] = &CHIP8::OP_8XY1;
     table8[0x2] = &CHIP8::OP_8XY2;
@@ -90,16 +185,20 @@ private:
     table8[0x6] = &CHIP8::OP_8XY6;
     table8[0x7] = &CHIP8::OP_8XY7;
     table8[0xe] = &CHIP8::OP_8XYE;
+    return table8;
   }
 
-  inline void init_tableE() {
-    std::fill(tableE.begin(), tableE.end(), &CHIP8::OP_NULL);
+  static std::array<CHIP8Func, 0xe + 1> make_tableE() {
+    std::array<CHIP8Func, 0xe + 1> tableE;
+    tableE.fill(&CHIP8::OP_NULL);
     tableE[0x1] = &CHIP8::OP_EXA1;
     tableE[0xe] = &CHIP8::OP_EX9E;
+    return tableE;
   }
 
-  inline void init_tableF() {
-    std::fill(tableF.begin(), tableF.end(), &CHIP8::OP_NULL);
+  static std::array<CHIP8Func, 0x65 + 1> make_tableF() {
+    std::array<CHIP8Func, 0x65 + 1> tableF;
+    tableF.fill(&CHIP8::OP_NULL);
     tableF[0x07] = &CHIP8::OP_FX07;
     tableF[0x0a] = &CHIP8::OP_FX0A;
     tableF[0x15] = &CHIP8::OP_FX15;
@@ -109,6 +208,7 @@ private:
     tableF[0x33] = &CHIP8::OP_FX33;
     tableF[0x55] = &CHIP8::OP_FX55;
     tableF[0x65] = &CHIP8::OP_FX65;
+    return tableF;
   }
 
   inline void Table0() {
@@ -135,17 +235,117 @@ private:
 
   inline WORD get_nnn() { return opcode & 0x0fff; }
 
+  // Result first, flag second, so VF ends up holding the flag when X = F
+  inline void set_with_flag(uint8_t reg_x_index, BYTE result, BYTE flag) {
+    registers[reg_x_index] = result;
+    registers[0xf] = flag;
+  }
+
+  // 8XY1-3 are plain logic ops apart from the VF reset quirk, which is a
+  // mask here rather than a branch: 0x00 clears VF, 0xff keeps it
+  inline void set_logic_result(uint8_t reg_x_index, BYTE result) {
+    registers[reg_x_index] = result;
+    registers[0xf] &= quirks.logic_resets_vf ? 0x00 : 0xff;
+  }
+
+  // The operand 8XY6/8XYE shift
+  inline BYTE shift_source() {
+    return registers[quirks.shift_uses_vy ? get_reg_y_index()
+                                          : get_reg_x_index()];
+  }
+
+  typedef void (CHIP8::*DrawFunc)(uint8_t x_pos, uint8_t y_pos);
+
+  /**
+   * DXYN kernels, specialized by sprite height and by whether the sprite
+   * crosses the right or bottom edge. The common unclipped case unrolls to
+   * one load, shift, AND and XOR per row. Indexed by height * 2 + clipped.
+   */
+  template <int Height, bool Clipped>
+  void draw_sprite(uint8_t x_pos, uint8_t y_pos);
+
+  template <std::size_t... Index>
+  static constexpr std::array<DrawFunc, 32>
+  make_draw_table(std::index_sequence<Index...>) {
+    return {{&CHIP8::draw_sprite<Index / 2, Index % 2 != 0>...}};
+  }
+
+  static const std::array<DrawFunc, 32> draw_table;
+
+  // Zeros and the font, shared by every new instance
+  static const Memory &boot_memory();
+
+  // Reads through the const operator[], which never copies a page
+  inline BYTE read(std::size_t address) const { return memory[address]; }
+
+  inline WORD fetch() const {
+    return read(program_counter) << 8 | read(program_counter + 1);
+  }
+  // Moves past opcode and runs it
+  inline void execute(WORD op) {
+#ifdef CHIP8_TRACE
+    if (trace) {
+      traced_execute(op);
+      return;
+    }
+#endif
+    dispatch(op);
+  }
+#ifdef CHIP8_TRACE
+  /**
+   * Only Vx and VF can change, apart from FX65's V0-Vx, so comparing those
+   * bytes finds what changed. (Comparing the whole array as words would
+   * stall on the byte the instruction just stored.)
+   */
+  inline void traced_execute(WORD op) {
+    WORD pc = program_counter;
+    int x = (op >> 8) & 0xf;
+    if ((op & 0xf0ff) == 0xf065) {
+      std::array<BYTE, 16> before = registers;
+      dispatch(op);
+      uint16_t changed = 0;
+      for (int i = 0; i < 16; i++) {
+        changed |= uint16_t(before[i] != registers[i]) << i;
+      }
+      trace->record_many(pc, op, changed, registers);
+      return;
+    }
+    BYTE vx = registers[x], vf = registers[0xf];
+    dispatch(op);
+    trace->record(pc, op, x, registers[x], registers[0xf], registers[x] != vx,
+                  registers[0xf] != vf);
+  }
+#endif
+  inline void dispatch(WORD op) {
+    opcode = op;
+    program_counter += 2;
+    // 4 (right half of left byte) + 8 (right byte)
+    (this->*table[opcode >> 12])();
+  }
+
+  /**
+   * Zobrist-style XOR of a term per nonzero memory byte, updated by every
+   * write the interpreter makes (load_rom, FX33, FX55), so state_hash()
+   * never has to scan memory.
+   */
+  uint64_t memory_hash = 0;
+  void write(std::size_t address, BYTE value);
+  // FNV-1a of registers, I, PC, stack, timers and keypad onto hash
+  uint64_t fold_cpu_state(uint64_t hash) const;
+  // The part of a VIP cost that depends on the state opcode runs in
+  int vip_variable_cost(WORD opcode) const;
+
 public:
-  std::array<BYTE, 4096> memory;
+  Memory memory;
   std::array<BYTE, 16> registers;
   WORD address_i;
   WORD program_counter;
-  std::vector<WORD> stack;
+  CallStack stack;
   BYTE delay_timer;
   BYTE sound_timer;
   WORD opcode;
 
-  std::array<std::array<uint32_t, 64>, 32> screen;
+  Frame screen;
 
   //  Keypad       Keyboard
   // +-+-+-+-+    +-+-+-+-+
@@ -160,41 +360,109 @@ public:
   // https://austinmorlan.com/posts/chip8_emulator/
   std::array<BYTE, 16> keypad;
 
-  std::array<CHIP8Func, 0xf + 1> table; // indexes by leftmost digit
-  std::array<CHIP8Func, 0xe + 1> table0;
-  std::array<CHIP8Func, 0xe + 1> table8;
-  std::array<CHIP8Func, 0xe + 1> tableE;
-  std::array<CHIP8Func, 0x65 + 1> tableF;
-
-  std::default_random_engine randGen;
-  std::uniform_int_distribution<BYTE> rand_byte;
+  Quirks quirks;
 
-  CHIP8()
-      : address_i(0), program_counter(0), delay_timer(0), sound_timer(0),
-        opcode(0),
-        randGen(std::chrono::system_clock::now().time_since_epoch().count()) {
-    program_counter = START_ADDRESS;
+  // Shared by every instance, so copying one doesn't copy them
+  static const std::array<CHIP8Func, 0xf + 1> table; // by leftmost digit
+  static const std::array<CHIP8Func, 0xe + 1> table0;
+  static const std::array<CHIP8Func, 0xe + 1> table8;
+  static const std::array<CHIP8Func, 0xe + 1> tableE;
+  static const std::array<CHIP8Func, 0x65 + 1> tableF;
 
-    std::copy(fontset.begin(), fontset.end(),
-              memory.begin() + FONTSET_START_ADDRESS);
+  // Frames completed by run_frame()/run_until()
+  uint64_t frame_number = 0;
+  int cycles_per_frame = DEFAULT_CYCLES_PER_FRAME;
+  // Instead of cycles_per_frame, frames run as many instructions as fit in
+  // a COSMAC VIP frame, charged at VIP cycle costs (vip-timing/vip-timing.h)
+  bool vip_timing = false;
+  // Machine cycles left in this frame: negative when the last instruction
+  // overran, which the next frame pays for
+  int vip_budget = 0;
 
-    rand_byte = std::uniform_int_distribution<BYTE>(0, 255U);
+  // CXKK draws from random unless random_source is set (not owned), e.g. to
+  // replay a recorded run
+  FastRandom random;
+  RandomSource *random_source = nullptr;
 
-    init_main_table();
-    init_table0();
-    init_table8();
-    init_tableE();
-    init_tableF();
+#ifdef CHIP8_TRACE
+  // Records every instruction and frame when set (not owned). Copies of an
+  // instance share it, so give each copy its own or none.
+  TraceRing *trace = nullptr;
+#endif
 
+  CHIP8()
+      : random(std::chrono::system_clock::now().time_since_epoch().count()) {
     reset();
-    reset_screen();
-    reset_keypad();
   }
+  /**
+   * Back to power-on: memory holds only the font, and registers, stack,
+   * timers, keypad, display and frame_number are cleared. Settings (quirks,
+   * timing, the RNG and its source, trace) are kept.
+   */
   void reset();
   void reset_screen();
   void reset_keypad();
-  void load_rom(const std::string filename);
+  // false if the file can't be read or doesn't fit in memory
+  bool load_rom(const std::string filename);
+  bool load_rom(const uint8_t *data, std::size_t size);
+  // Makes CXKK reproducible: the same seed gives the same bytes
+  inline void seed(uint64_t seed) { random.seed(seed); }
   void cycle();
+  // Called once per 60 Hz frame, independent of how many cycles ran
+  void tick_timers();
+
+  /**
+   * The embedding API: what the frontends, the C shim (chip8_c.h) and
+   * harnesses driving many instances should use rather than the members
+   * above.
+   */
+  // Executes cycles instructions without touching the timers
+  void step(int cycles);
+  /**
+   * One frame's worth of instructions at VIP speed, without touching the
+   * timers. DXYN waits for the display interrupt as on the VIP: met
+   * anywhere but at the top of a frame, it ends the frame and runs first in
+   * the next one. Returns how many instructions ran.
+   */
+  int step_vip_frame();
+  // cycles_per_frame instructions (or a VIP frame's), then one timer tick
+  void run_frame();
+  // Runs whole frames until frame_number reaches frame
+  void run_until(uint64_t frame);
+  inline void set_key(int key, bool pressed) {
+    keypad[key & 0xf] = pressed ? 1 : 0;
+  }
+  // The live display, no copy: WIDTH bits per row, bit 63 leftmost
+  inline const Frame &frame_view() const { return screen; }
+  /**
+   * FNV-1a over everything that decides what happens next: memory,
+   * registers, I, PC, stack, timers, keypad and the display. The RNG state
+   * isn't included, so seed both sides when comparing runs.
+   */
+  uint64_t state_digest() const;
+  /**
+   * The same state as state_digest() in constant time, for loop detection,
+   * deduplicating explored states and quick equality checks: memory's part
+   * is maintained as it's written, and the rest is a few dozen words.
+   * Equal states give equal hashes, though not state_digest()'s values.
+   * Code that writes memory directly, rather than through instructions,
+   * load_rom() or restore_state(), must call rehash() afterwards.
+   */
+  uint64_t state_hash() const;
+  void rehash();
+  /**
+   * Appends the same state plus frame_number to out as a versioned blob,
+   * for snapshots that outlive the instance (sent over a socket, written to
+   * disk). restore_state() returns false and changes nothing if the blob is
+   * malformed or from another version.
+   */
+  void save_state(std::vector<uint8_t> &out) const;
+  bool restore_state(const uint8_t *data, std::size_t size);
+
+  // 0xffffffff if the pixel is lit, 0 otherwise
+  inline uint32_t pixel(int x, int y) const {
+    return (screen[y] >> (WIDTH - 1 - x)) & 1 ? 0xffffffff : 0;
+  }
   // Do nothing
   void OP_NULL();
   // CLS
@@ -228,15 +496,17 @@ public:
   // Sub Vx, Vy
   void OP_8XY5();
   /**
-   * SHR Vx
-   * We use the shift in place for Register X and move the shifted bit to Reg F
+   * SHR Vx {, Vy}
+   * Shifts Register X in place (or Register Y into X with the shift_uses_vy
+   * quirk) and moves the shifted out bit to Reg F
    */
   void OP_8XY6();
   // SUBN Vx, Vy
   void OP_8XY7();
   /**
    * SHL Vx {, Vy}
-   * We use the shift in place for Register X and move the shifted bit to Reg F
+   * Shifts Register X in place (or Register Y into X with the shift_uses_vy
+   * quirk) and moves the shifted out bit to Reg F
    */
   void OP_8XYE();
   // SNE Vx, Vy
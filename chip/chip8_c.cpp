@@ -0,0 +1,42 @@
+#include "chip8_c.h"
+#include "chip8.h"
+
+static_assert(CHIP8_DISPLAY_WIDTH == WIDTH && CHIP8_DISPLAY_HEIGHT == HEIGHT,
+              "chip8_c.h is out of step with chip8.h");
+
+// The opaque handle is the CHIP8 itself
+struct chip8 : CHIP8 {};
+
+chip8 *chip8_create(uint64_t seed) {
+  chip8 *chip = new chip8();
+  chip->seed(seed);
+  return chip;
+}
+
+void chip8_destroy(chip8 *chip) { delete chip; }
+
+int chip8_load_rom(chip8 *chip, const uint8_t *data, size_t size) {
+  return chip->load_rom(data, size) ? 1 : 0;
+}
+
+void chip8_set_cycles_per_frame(chip8 *chip, int cycles) {
+  chip->cycles_per_frame = cycles;
+}
+
+void chip8_step(chip8 *chip, int cycles) { chip->step(cycles); }
+
+void chip8_run_until(chip8 *chip, uint64_t frame) { chip->run_until(frame); }
+
+uint64_t chip8_frame_number(const chip8 *chip) { return chip->frame_number; }
+
+void chip8_set_key(chip8 *chip, int key, int pressed) {
+  chip->set_key(key, pressed != 0);
+}
+
+const uint64_t *chip8_frame_view(const chip8 *chip) {
+  return chip->frame_view().data();
+}
+
+int chip8_sound_active(const chip8 *chip) { return chip->sound_timer > 0; }
+
+uint64_t chip8_state_digest(const chip8 *chip) { return chip->state_digest(); }
@@ -0,0 +1,57 @@
+#pragma once
+
+/**
+ * C ABI over the embedding API, for FFI from Python, Go and the like. Every
+ * function takes the handle chip8_create() returned. Handles are independent,
+ * so different threads can drive different instances.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// libchip8.so is built with hidden visibility; only these are exported
+#if defined(__GNUC__)
+#define CHIP8_API __attribute__((visibility("default")))
+#else
+#define CHIP8_API
+#endif
+
+#define CHIP8_DISPLAY_WIDTH 64
+#define CHIP8_DISPLAY_HEIGHT 32
+
+typedef struct chip8 chip8;
+
+// A reset machine with the font loaded and CXKK seeded with seed
+CHIP8_API chip8 *chip8_create(uint64_t seed);
+CHIP8_API void chip8_destroy(chip8 *chip);
+
+// 1 on success, 0 if the ROM doesn't fit
+CHIP8_API int chip8_load_rom(chip8 *chip, const uint8_t *data, size_t size);
+
+CHIP8_API void chip8_set_cycles_per_frame(chip8 *chip, int cycles);
+CHIP8_API void chip8_step(chip8 *chip, int cycles);
+CHIP8_API void chip8_run_until(chip8 *chip, uint64_t frame);
+CHIP8_API uint64_t chip8_frame_number(const chip8 *chip);
+
+// key is 0x0-0xf, pressed is 0 or 1
+CHIP8_API void chip8_set_key(chip8 *chip, int key, int pressed);
+
+/**
+ * CHIP8_DISPLAY_HEIGHT rows of one uint64_t each, bit 63 the leftmost pixel.
+ * Points into the instance, so it stays valid and current until
+ * chip8_destroy(): read it after each step without copying.
+ */
+CHIP8_API const uint64_t *chip8_frame_view(const chip8 *chip);
+
+// Nonzero while the sound timer is running
+CHIP8_API int chip8_sound_active(const chip8 *chip);
+
+CHIP8_API uint64_t chip8_state_digest(const chip8 *chip);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "../audio/audio.h"
+#include "../chip/chip8.h"
+#include "../input-queue/input-queue.h"
+#include "../metrics/metrics.h"
+#include "../recorder/recorder.h"
+#include "../triple-buffer/triple-buffer.h"
+
+/**
+ * Runs a CHIP8 on its own thread, paced to 60 emulated frames per second.
+ * Each frame runs the cycles owed for that frame, draining input between
+ * cycles, renders the frame's audio, ticks the timers and publishes the
+ * screen to the triple buffer.
+ * The thread never waits on the renderer, so a vsync'd present can't slow
+ * emulation down.
+ *
+ * Speed can be scaled for slow motion or fast forward. Timers tick once per
+ * emulated frame either way, so they keep their 60 Hz meaning relative to
+ * the program. Turbo drops pacing altogether, mutes audio and only publishes
+ * every Nth frame, so it runs as fast as the core can.
+ *
+ * load() swaps in another machine, e.g. a different ROM, between two frames
+ * while the window, audio and recorder carry on.
+ */
+class EmulatorThread {
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  CHIP8 &chip;
+  InputQueue &input;
+  TripleBuffer<Frame> &frames;
+  AudioStream *audio; // optional
+  std::atomic<Recorder *> recorder;
+  std::atomic<Metrics *> metrics;
+  double cycles_per_frame;
+  int turbo_frameskip;
+  std::atomic<bool> turbo;
+  std::atomic<double> speed;
+  std::atomic<bool> running;
+  // set by load(), copied over chip at the start of the next frame
+  std::mutex pending_mutex;
+  CHIP8 pending;
+  std::atomic<bool> has_pending;
+  std::thread thread; // declared last so it starts after everything above
+
+  void run() {
+    auto next_frame = Clock::now();
+    double cycle_budget = 0;
+
+    for (uint64_t frame = 0; running.load(std::memory_order_relaxed);
+         frame++) {
+      bool fast = turbo.load(std::memory_order_relaxed);
+      double frame_speed = speed.load(std::memory_order_relaxed);
+      Metrics *m = metrics.load(std::memory_order_acquire);
+      auto frame_start = m ? Clock::now() : Clock::time_point();
+      Histogram *latency = m ? &m->input_latency_ns : nullptr;
+
+      if (has_pending.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        chip = pending;
+        has_pending.store(false, std::memory_order_relaxed);
+        cycle_budget = 0;
+      }
+      int ran = 0;
+      if (chip.vip_timing) {
+        input.drain(chip.keypad, latency);
+        ran = chip.step_vip_frame();
+      } else {
+        cycle_budget += cycles_per_frame;
+        for (; cycle_budget >= 1; cycle_budget -= 1, ran++) {
+          input.drain(chip.keypad, latency);
+          chip.cycle();
+        }
+      }
+      if (audio && !fast) {
+        // a slowed down frame lasts longer, so it needs more samples
+        audio->frame(chip.sound_timer > 0, 1.0 / frame_speed);
+      }
+      chip.tick_timers();
+
+      if (Recorder *r = recorder.load(std::memory_order_acquire)) {
+        r->submit(chip.screen);
+      }
+      if (!fast || frame % turbo_frameskip == 0) {
+        frames.write_buffer() = chip.screen;
+        frames.publish();
+      }
+      if (m) {
+        m->instructions.add(ran);
+        m->frames.add(1);
+        m->frame_ns.record(nanoseconds(Clock::now() - frame_start));
+      }
+
+      if (fast) {
+        next_frame = Clock::now();
+        continue;
+      }
+
+      const auto frame_time = std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(1.0 /
+                                        (FRAMES_PER_SECOND * frame_speed)));
+      next_frame += frame_time;
+      // If we fell far behind (stopped in a debugger, machine suspended)
+      // start over from now instead of running a burst of frames to catch up
+      if (Clock::now() - next_frame > 5 * frame_time) {
+        next_frame = Clock::now();
+      }
+      if (m) {
+        auto idle_start = Clock::now();
+        std::this_thread::sleep_until(next_frame);
+        m->idle_ns.add(nanoseconds(Clock::now() - idle_start));
+      } else {
+        std::this_thread::sleep_until(next_frame);
+      }
+    }
+  }
+
+  static uint64_t nanoseconds(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+        .count();
+  }
+
+public:
+  EmulatorThread(CHIP8 &chip, InputQueue &input, TripleBuffer<Frame> &frames,
+                 double cycles_per_frame, AudioStream *audio = nullptr,
+                 int turbo_frameskip = 10)
+      : chip(chip), input(input), frames(frames), audio(audio),
+        recorder(nullptr), metrics(nullptr), cycles_per_frame(cycles_per_frame),
+        turbo_frameskip(std::max(1, turbo_frameskip)), turbo(false),
+        speed(1.0), running(true), has_pending(false),
+        thread(&EmulatorThread::run, this) {}
+
+  ~EmulatorThread() { stop(); }
+
+  void set_turbo(bool on) { turbo.store(on, std::memory_order_relaxed); }
+  bool is_turbo() const { return turbo.load(std::memory_order_relaxed); }
+
+  // 1.0 is real time, 0.25 is quarter speed
+  void set_speed(double multiplier) {
+    speed.store(multiplier, std::memory_order_relaxed);
+  }
+  double get_speed() const { return speed.load(std::memory_order_relaxed); }
+
+  /**
+   * Every emulated frame, turbo or not, is also handed to the recorder.
+   * Pass nullptr to stop recording. The recorder must outlive this thread.
+   */
+  void set_recorder(Recorder *r) {
+    recorder.store(r, std::memory_order_release);
+  }
+
+  /**
+   * Counts instructions, frames and idle time into metrics' emulator thread
+   * fields from the next frame on. Pass nullptr to stop. The metrics must
+   * outlive this thread.
+   */
+  void set_metrics(Metrics *m) { metrics.store(m, std::memory_order_release); }
+
+  /**
+   * Replaces the running machine with a copy of next from the next frame
+   * on; a later call before then wins. The keypad comes from next too, so
+   * keys held through the switch count as released until pressed again.
+   */
+  void load(const CHIP8 &next) {
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    pending = next;
+    has_pending.store(true, std::memory_order_release);
+  }
+
+  void stop() {
+    running.store(false, std::memory_order_relaxed);
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+};
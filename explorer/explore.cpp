@@ -0,0 +1,124 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "explorer.h"
+
+namespace {
+
+void print_inputs(const std::vector<InputChoice> &inputs) {
+  if (inputs.empty()) {
+    std::cout << " without input";
+  }
+  for (const InputChoice &choice : inputs) {
+    std::cout << ' ' << choice.frame << ':';
+    if (choice.key < 0) {
+      std::cout << "none";
+    } else {
+      std::cout << std::hex << choice.key << std::dec;
+    }
+  }
+  std::cout << '\n';
+}
+
+// An address or opcode as width hex digits
+void print_hex(unsigned value, int width) {
+  std::cout << std::hex << std::setfill('0') << std::setw(width) << value
+            << std::dec << std::setfill(' ');
+}
+
+} // namespace
+
+// Explores every input to a ROM breadth first and reports faults, with the
+// input that reaches each, and which of the ROM's bytes ever ran:
+//   ./explore_bin --depth 20 --states 50000 ../demo-roms/pong.ch8
+// An input is frame:key, the keypad from that frame on holding only that
+// key (or none). Unreached bytes are often sprite data rather than code.
+int main(int argc, char *argv[]) {
+  ExploreOptions options;
+  bool vip = false;
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--depth" && has_value) {
+      options.max_depth = std::atoi(argv[++i]);
+    } else if (arg == "--states" && has_value) {
+      options.max_states = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--segment-frames" && has_value) {
+      options.segment_frames = std::atoi(argv[++i]);
+    } else if (arg == "--threads" && has_value) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--vip") {
+      vip = true;
+    } else if (path.empty() && arg.compare(0, 2, "--") != 0) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+  if (path.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--depth <n>] [--states <n>] [--segment-frames <n>]"
+                 " [--threads <n>] [--vip] <ROM>"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  std::size_t rom_size = file ? std::size_t(file.tellg()) : 0;
+  CHIP8 chip;
+  chip.seed(0);
+  if (vip) {
+    chip.quirks = Quirks::cosmac_vip();
+  }
+  if (!file || !chip.load_rom(path)) {
+    std::cerr << "Can't load " << path << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  ExploreReport report = explore(chip, options);
+  std::cout << path << ": " << report.states << " states ("
+            << report.duplicates << " revisits), " << report.screens
+            << " screens, depth " << report.depth
+            << (report.truncated ? ", truncated" : "") << '\n';
+
+  std::size_t covered = 0;
+  for (std::size_t a = START_ADDRESS; a < START_ADDRESS + rom_size; a++) {
+    covered += report.reached[a];
+  }
+  std::cout << "coverage: " << covered << " of " << rom_size
+            << " ROM bytes ran (" << std::fixed << std::setprecision(0)
+            << (rom_size ? 100.0 * covered / rom_size : 0.0) << "%)\n";
+  std::cout << "unreached:";
+  for (std::size_t a = START_ADDRESS; a < START_ADDRESS + rom_size; a++) {
+    if (report.reached[a]) {
+      continue;
+    }
+    std::size_t last = a;
+    while (last + 1 < START_ADDRESS + rom_size && !report.reached[last + 1]) {
+      last++;
+    }
+    std::cout << ' ';
+    print_hex(a, 3);
+    if (last != a) {
+      std::cout << '-';
+      print_hex(last, 3);
+    }
+    a = last;
+  }
+  std::cout << '\n';
+
+  for (const Fault &fault : report.faults) {
+    std::cout << "fault: " << fault.reason << " at ";
+    print_hex(fault.pc, 3);
+    std::cout << " (";
+    print_hex(fault.opcode, 4);
+    std::cout << "), frame " << fault.frame << ", after";
+    print_inputs(fault.inputs);
+  }
+  return report.faults.empty() ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+#include "explorer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+
+// Forks from the start state keep the keypad as it is
+const int KEEP_KEYPAD = -2;
+
+// splitmix64's finalizer, to spread the in-frame position over the hash
+uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+uint64_t screen_hash(const Frame &screen) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (uint64_t row : screen) {
+    hash = (hash ^ row) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+bool reads_keypad(WORD opcode) {
+  return (opcode & 0xf0ff) == 0xe09e || (opcode & 0xf0ff) == 0xe0a1 ||
+         (opcode & 0xf0ff) == 0xf00a;
+}
+
+WORD opcode_at(const CHIP8 &chip, std::size_t address) {
+  return chip.memory[address] << 8 | chip.memory[address + 1];
+}
+
+// A state waiting to execute the instruction that reads the keypad
+struct Node {
+  CHIP8 chip;
+  // Instructions left in the current frame
+  int cycles_left;
+  // Index into the path steps, to rebuild the input that led here
+  uint32_t step;
+};
+
+struct PathStep {
+  uint32_t parent;
+  InputChoice choice;
+};
+
+// What one fork ran into
+struct Branch {
+  explicit Branch(const Node &from) : node(from) {}
+
+  InputChoice choice;
+  const char *fault = nullptr;
+  WORD pc = 0;
+  WORD opcode = 0;
+  uint64_t frame = 0;
+  bool decision = false;
+  Node node;
+};
+
+struct Expansion {
+  std::vector<Branch> branches;
+  std::bitset<MEMORY_SIZE> reached;
+};
+
+/**
+ * Runs from node until the next instruction reads the keypad (skipping the
+ * one node is waiting on, which the choice has answered), something
+ * faults, or segment_frames frames pass.
+ */
+void run_branch(Branch &branch, int segment_frames,
+                std::bitset<MEMORY_SIZE> &reached, bool answered) {
+  CHIP8 &chip = branch.node.chip;
+  int &cycles_left = branch.node.cycles_left;
+  for (int frames = 0;;) {
+    if (cycles_left == 0) {
+      chip.tick_timers();
+      chip.frame_number++;
+      cycles_left = chip.cycles_per_frame;
+      if (++frames > segment_frames) {
+        return;
+      }
+    }
+    branch.pc = chip.program_counter;
+    branch.frame = chip.frame_number;
+    if (branch.pc >= MEMORY_SIZE - 1) {
+      branch.fault = "PC outside memory";
+      return;
+    }
+    branch.opcode = opcode_at(chip, branch.pc);
+    if (!answered && reads_keypad(branch.opcode)) {
+      branch.decision = true;
+      return;
+    }
+    answered = false;
+    if ((branch.fault = fault_reason(chip, branch.opcode))) {
+      return;
+    }
+    reached[branch.pc] = true;
+    reached[branch.pc + 1] = true;
+    chip.cycle();
+    cycles_left--;
+  }
+}
+
+Expansion expand(const Node &node, int segment_frames) {
+  Expansion expansion;
+  std::vector<int> keys;
+  if (node.step == 0) {
+    keys.push_back(KEEP_KEYPAD);
+  } else {
+    WORD opcode = opcode_at(node.chip, node.chip.program_counter);
+    if (opcode >> 12 == 0xf) {
+      for (int key = 0; key < 16; key++) {
+        keys.push_back(key);
+      }
+    } else {
+      keys.push_back(-1);
+      keys.push_back(node.chip.registers[opcode >> 8 & 0xf]);
+    }
+  }
+
+  for (int key : keys) {
+    Branch branch(node);
+    branch.choice = {node.chip.frame_number, key};
+    if (key != KEEP_KEYPAD) {
+      branch.node.chip.reset_keypad();
+      if (key >= 0 && key < 16) {
+        branch.node.chip.set_key(key, true);
+      }
+    }
+    run_branch(branch, segment_frames, expansion.reached,
+               key != KEEP_KEYPAD);
+    expansion.branches.push_back(std::move(branch));
+  }
+  return expansion;
+}
+
+std::vector<InputChoice> inputs_to(const std::vector<PathStep> &steps,
+                                   uint32_t step, const InputChoice &last) {
+  std::vector<InputChoice> inputs;
+  for (InputChoice choice = last;; choice = steps[step].choice,
+                   step = steps[step].parent) {
+    if (choice.key != KEEP_KEYPAD) {
+      inputs.push_back(choice);
+    }
+    if (step == 0) {
+      break;
+    }
+  }
+  std::reverse(inputs.begin(), inputs.end());
+  return inputs;
+}
+
+} // namespace
+
+bool HashSet::insert(uint64_t hash) {
+  hash = hash ? hash : 1;
+  if (2 * (count + 1) > slots.size()) {
+    std::vector<uint64_t> old(2 * slots.size(), 0);
+    old.swap(slots);
+    count = 0;
+    for (uint64_t stored : old) {
+      if (stored) {
+        insert(stored);
+      }
+    }
+  }
+  std::size_t mask = slots.size() - 1;
+  for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+    if (slots[i] == hash) {
+      return false;
+    }
+    if (slots[i] == 0) {
+      slots[i] = hash;
+      count++;
+      return true;
+    }
+  }
+}
+
+const char *fault_reason(const CHIP8 &chip, WORD opcode) {
+  int x = opcode >> 8 & 0xf;
+  int n = opcode & 0xf;
+  std::size_t i = chip.address_i;
+  switch (opcode >> 12) {
+  case 0x0:
+    if (opcode == 0x0000) {
+      return "ran into zeroed memory";
+    }
+    if (CHIP8::table0[n] == &CHIP8::OP_NULL) {
+      return "unknown opcode";
+    }
+    if (n == 0xe && chip.stack.empty()) {
+      return "return with an empty stack";
+    }
+    return nullptr;
+  case 0x2:
+    return chip.stack.size() == CALL_STACK_DEPTH ? "call stack overflow"
+                                                 : nullptr;
+  case 0x8:
+    return CHIP8::table8[n] == &CHIP8::OP_NULL ? "unknown opcode" : nullptr;
+  case 0xd:
+    return i + n > MEMORY_SIZE ? "sprite read past the end of memory"
+                               : nullptr;
+  case 0xe:
+    if (CHIP8::tableE[n] == &CHIP8::OP_NULL) {
+      return "unknown opcode";
+    }
+    return chip.registers[x] > 0xf ? "key index above 0xF" : nullptr;
+  case 0xf:
+    if ((opcode & 0xff) >= CHIP8::tableF.size() ||
+        CHIP8::tableF[opcode & 0xff] == &CHIP8::OP_NULL) {
+      return "unknown opcode";
+    }
+    if ((opcode & 0xff) == 0x33 && i + 3 > MEMORY_SIZE) {
+      return "BCD store past the end of memory";
+    }
+    if (((opcode & 0xff) == 0x55 || (opcode & 0xff) == 0x65) &&
+        i + x + 1 > MEMORY_SIZE) {
+      return "register transfer past the end of memory";
+    }
+    return nullptr;
+  default:
+    return nullptr;
+  }
+}
+
+ExploreReport explore(const CHIP8 &start, const ExploreOptions &options) {
+  ExploreReport report;
+  HashSet visited;
+  std::unordered_set<uint64_t> screens;
+  std::set<std::pair<WORD, std::string>> faults_seen;
+  std::vector<PathStep> steps{{0, {0, KEEP_KEYPAD}}};
+  std::vector<Node> frontier{{start, start.cycles_per_frame, 0}};
+
+  int threads = options.threads;
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int level = 0; !frontier.empty(); level++) {
+    if (level > options.max_depth) {
+      report.truncated = true;
+      break;
+    }
+    report.depth = level;
+
+    std::vector<Expansion> expansions(frontier.size());
+    std::atomic<std::size_t> next(0);
+    auto work = [&] {
+      for (std::size_t i; (i = next.fetch_add(1)) < frontier.size();) {
+        expansions[i] = expand(frontier[i], options.segment_frames);
+      }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < std::min<int>(threads, frontier.size()); i++) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+
+    std::vector<Node> next_frontier;
+    for (std::size_t i = 0; i < frontier.size(); i++) {
+      report.reached |= expansions[i].reached;
+      for (Branch &branch : expansions[i].branches) {
+        if (branch.fault) {
+          if (faults_seen.emplace(branch.pc, branch.fault).second) {
+            report.faults.push_back(
+                {branch.fault, branch.pc, branch.opcode, branch.frame,
+                 inputs_to(steps, frontier[i].step, branch.choice)});
+          }
+          continue;
+        }
+        if (!branch.decision) {
+          continue;
+        }
+        const CHIP8 &chip = branch.node.chip;
+        if (!visited.insert(chip.state_hash() ^
+                            mix64(branch.node.cycles_left))) {
+          report.duplicates++;
+          continue;
+        }
+        if (visited.size() > options.max_states) {
+          report.truncated = true;
+          continue;
+        }
+        screens.insert(screen_hash(chip.screen));
+        steps.push_back({frontier[i].step, branch.choice});
+        branch.node.step = uint32_t(steps.size() - 1);
+        next_frontier.push_back(std::move(branch.node));
+      }
+    }
+    frontier.swap(next_frontier);
+  }
+
+  report.states = std::min(visited.size(), options.max_states);
+  report.screens = screens.size();
+  return report;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+/**
+ * Breadth-first exploration of what a ROM can do under every input.
+ *
+ * The only instructions that read the keypad are EX9E, EXA1 and FX0A, so a
+ * run is a chain of segments between those decision points. At each one
+ * the explorer forks the state: EX9E/EXA1 with key Vx released and held,
+ * FX0A with each of the 16 keys pressed. Each fork runs to its next
+ * decision point, and a state (by CHIP8::state_hash and its place in the
+ * frame) that was already reached is dropped, so polling loops don't
+ * multiply. A segment that runs segment_frames frames without reaching a
+ * decision has settled and isn't followed further.
+ *
+ * Before every instruction the explorer checks for faults: leaving memory,
+ * an opcode nothing decodes (0000 included: the usual sign of running off
+ * into empty memory), returning with an empty stack or calling past its
+ * depth, a key index above 0xF and memory accesses past the end. A faulting
+ * path stops, and the first (so shortest) input sequence to each distinct
+ * fault is reported.
+ *
+ * Frames run cycles_per_frame instructions; VIP timing isn't modelled.
+ * Levels are expanded in parallel, one state at a time per thread, and
+ * merged in order, so results don't depend on the thread count.
+ */
+
+struct ExploreOptions {
+  int threads = 0; // 0 for one per core
+  // Decisions along one path
+  int max_depth = 32;
+  // Distinct decision states kept; exploring stops when it's reached
+  std::size_t max_states = 20000;
+  int segment_frames = 300;
+};
+
+// At frame, the keypad became just key held, or nothing if key is -1
+struct InputChoice {
+  uint64_t frame;
+  int key;
+};
+
+struct Fault {
+  std::string reason;
+  WORD pc;
+  WORD opcode;
+  uint64_t frame;
+  std::vector<InputChoice> inputs;
+};
+
+struct ExploreReport {
+  // Distinct decision states reached, and forks that led to one again
+  uint64_t states = 0;
+  uint64_t duplicates = 0;
+  // Distinct displays at decision points
+  uint64_t screens = 0;
+  // Levels of decisions expanded
+  int depth = 0;
+  // Stopped at max_depth or max_states with paths left to follow
+  bool truncated = false;
+  // Addresses of both bytes of every instruction that ran
+  std::bitset<MEMORY_SIZE> reached;
+  std::vector<Fault> faults;
+};
+
+// Explores from start, which is usually a CHIP8 that has just loaded a ROM
+ExploreReport explore(const CHIP8 &start, const ExploreOptions &options);
+
+// Why executing opcode in chip's state would fault, or nullptr
+const char *fault_reason(const CHIP8 &chip, WORD opcode);
+
+/**
+ * A set of 64-bit hashes, open addressing with linear probing in one flat
+ * array that doubles at half full: 8 bytes per slot, where node-based sets
+ * spend several times that.
+ */
+class HashSet {
+private:
+  std::vector<uint64_t> slots; // 0 is empty, so 0 is stored as 1
+  std::size_t count = 0;
+
+public:
+  HashSet() : slots(1024, 0) {}
+  // false if hash was already there
+  bool insert(uint64_t hash);
+  std::size_t size() const { return count; }
+};
@@ -0,0 +1,149 @@
+#include "phosphor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Expands a byte of pixels, MSB first, to 8 bytes of 0x00 or 0xff
+const std::array<std::array<uint8_t, 8>, 256> bit_expand = [] {
+  std::array<std::array<uint8_t, 8>, 256> table;
+  for (int byte = 0; byte < 256; byte++) {
+    for (int i = 0; i < 8; i++) {
+      table[byte][i] = (byte >> (7 - i)) & 1 ? 0xff : 0x00;
+    }
+  }
+  return table;
+}();
+
+// Spreads the 32 bits of v out to the even bit positions of the result
+inline uint64_t spread_bits(uint32_t v) {
+  uint64_t x = v;
+  x = (x | x << 16) & 0x0000ffff0000ffffull;
+  x = (x | x << 8) & 0x00ff00ff00ff00ffull;
+  x = (x | x << 4) & 0x0f0f0f0f0f0f0f0full;
+  x = (x | x << 2) & 0x3333333333333333ull;
+  x = (x | x << 1) & 0x5555555555555555ull;
+  return x;
+}
+
+// Doubles a row of 64 pixels into 128 where each source pixel becomes the
+// pair (left[x], right[x])
+inline void interleave(uint64_t left, uint64_t right, uint64_t *out) {
+  out[0] = spread_bits(left >> 32) << 1 | spread_bits(right >> 32);
+  out[1] = spread_bits((uint32_t)left) << 1 | spread_bits((uint32_t)right);
+}
+
+} // namespace
+
+void scale2x_frame(const Frame &frame, uint64_t *out) {
+  for (int y = 0; y < HEIGHT; y++) {
+    // Out of range neighbours repeat the edge pixel
+    const uint64_t e = frame[y];
+    const uint64_t b = y > 0 ? frame[y - 1] : e;          // above
+    const uint64_t h = y < HEIGHT - 1 ? frame[y + 1] : e; // below
+    const uint64_t d = e >> 1 | (e & 1ull << 63);         // left
+    const uint64_t f = e << 1 | (e & 1);                  // right
+
+    // The Scale2x rules, 64 pixels at a time. For the top-left quarter:
+    // E0 = D == B && B != F && D != H ? D : E
+    const uint64_t s0 = ~(d ^ b) & (b ^ f) & (d ^ h);
+    const uint64_t s1 = ~(b ^ f) & (b ^ d) & (f ^ h);
+    const uint64_t s2 = ~(d ^ h) & (d ^ b) & (h ^ f);
+    const uint64_t s3 = ~(h ^ f) & (d ^ h) & (b ^ f);
+    const uint64_t e0 = (s0 & d) | (~s0 & e);
+    const uint64_t e1 = (s1 & f) | (~s1 & e);
+    const uint64_t e2 = (s2 & d) | (~s2 & e);
+    const uint64_t e3 = (s3 & f) | (~s3 & e);
+
+    interleave(e0, e1, out + (2 * y) * 2);
+    interleave(e2, e3, out + (2 * y + 1) * 2);
+  }
+}
+
+void phosphor_step_scalar(uint8_t *intensity, const uint8_t *lit,
+                          std::size_t count, uint8_t decay) {
+  for (std::size_t i = 0; i < count; i++) {
+    intensity[i] = lit[i] | (uint8_t)((intensity[i] * decay) >> 8);
+  }
+}
+
+void phosphor_step(uint8_t *intensity, const uint8_t *lit, std::size_t count,
+                   uint8_t decay) {
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i factor = _mm_set1_epi16(decay);
+  for (; i + 16 <= count; i += 16) {
+    __m128i current = _mm_loadu_si128((const __m128i *)(intensity + i));
+    __m128i on = _mm_loadu_si128((const __m128i *)(lit + i));
+    __m128i low = _mm_unpacklo_epi8(current, zero);
+    __m128i high = _mm_unpackhi_epi8(current, zero);
+    low = _mm_srli_epi16(_mm_mullo_epi16(low, factor), 8);
+    high = _mm_srli_epi16(_mm_mullo_epi16(high, factor), 8);
+    __m128i faded = _mm_packus_epi16(low, high);
+    _mm_storeu_si128((__m128i *)(intensity + i), _mm_or_si128(faded, on));
+  }
+#endif
+  phosphor_step_scalar(intensity + i, lit + i, count - i, decay);
+}
+
+PhosphorFilter::PhosphorFilter(int scale, double decay, bool scale2x,
+                               bool scanlines)
+    : source_width(scale2x ? WIDTH * 2 : WIDTH),
+      source_height(scale2x ? HEIGHT * 2 : HEIGHT),
+      pixel_scale(std::max(1, scale2x ? scale / 2 : scale)),
+      scale2x(scale2x), scanlines(scanlines),
+      decay((uint8_t)std::max(0.0, std::min(255.0, decay * 256))),
+      bits(source_height * source_width / 64, 0),
+      lit(source_width * source_height, 0),
+      intensity(source_width * source_height, 0) {
+  for (int i = 0; i < 256; i++) {
+    uint32_t level = i;
+    uint32_t dim = i * 5 / 8;
+    palette[i] = level << 24 | level << 16 | level << 8 | 0xff;
+    scanline_palette[i] = dim << 24 | dim << 16 | dim << 8 | 0xff;
+  }
+}
+
+void PhosphorFilter::apply(const Frame &frame, uint32_t *out, int pitch) {
+  if (scale2x) {
+    scale2x_frame(frame, bits.data());
+  } else {
+    std::copy(frame.begin(), frame.end(), bits.begin());
+  }
+
+  for (std::size_t w = 0; w < bits.size(); w++) {
+    for (int i = 0; i < 8; i++) {
+      const uint8_t byte = bits[w] >> (56 - 8 * i);
+      std::memcpy(&lit[w * 64 + i * 8], bit_expand[byte].data(), 8);
+    }
+  }
+  phosphor_step(intensity.data(), lit.data(), intensity.size(), decay);
+
+  // Build the first output line of each source row, then copy it down
+  const int width = output_width();
+  const bool dim_last = scanlines && pixel_scale > 1;
+  for (int y = 0; y < source_height; y++) {
+    const uint8_t *row = &intensity[y * source_width];
+    uint32_t *first = (uint32_t *)((uint8_t *)out + y * pixel_scale * pitch);
+    for (int x = 0; x < source_width; x++) {
+      std::fill_n(first + x * pixel_scale, pixel_scale, palette[row[x]]);
+    }
+    for (int line = 1; line < pixel_scale; line++) {
+      uint32_t *dest = (uint32_t *)((uint8_t *)first + line * pitch);
+      if (dim_last && line == pixel_scale - 1) {
+        for (int x = 0; x < source_width; x++) {
+          std::fill_n(dest + x * pixel_scale, pixel_scale,
+                      scanline_palette[row[x]]);
+        }
+      } else {
+        std::memcpy(dest, first, width * sizeof(uint32_t));
+      }
+    }
+  }
+}
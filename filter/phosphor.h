@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+/**
+ * Software post-process that hides XOR flicker.
+ * Lit pixels go to full brightness and unlit ones fade out over a few
+ * frames, like the phosphor on a CRT. Optionally the frame is first smoothed
+ * to twice the resolution with Scale2x, and every pixel row's last output
+ * line is dimmed to look like scanlines. Output is RGBA8888, ready for a
+ * streaming texture, at output_width() x output_height().
+ */
+class PhosphorFilter {
+private:
+  int source_width;  // 64, or 128 with scale2x
+  int source_height; // 32, or 64 with scale2x
+  int pixel_scale;   // output pixels per source pixel
+  bool scale2x;
+  bool scanlines;
+  uint8_t decay; // brightness kept per frame, out of 256
+
+  std::vector<uint64_t> bits;     // source_height rows of 1 or 2 words
+  std::vector<uint8_t> lit;       // bits expanded to 0x00 / 0xff bytes
+  std::vector<uint8_t> intensity; // source_width * source_height
+  std::array<uint32_t, 256> palette;
+  std::array<uint32_t, 256> scanline_palette;
+
+public:
+  /**
+   * scale is the window scale. decay is the fraction of brightness an unlit
+   * pixel keeps each frame, 0 for none.
+   */
+  PhosphorFilter(int scale, double decay, bool scale2x, bool scanlines);
+
+  int output_width() const { return source_width * pixel_scale; }
+  int output_height() const { return source_height * pixel_scale; }
+
+  // pitch is in bytes, as SDL_LockTexture reports it
+  void apply(const Frame &frame, uint32_t *out, int pitch);
+};
+
+/**
+ * One frame of phosphor decay over count pixels: bytes of lit become 255,
+ * the rest are scaled by decay / 256. Uses SSE2 when available; the scalar
+ * version is the reference.
+ */
+void phosphor_step(uint8_t *intensity, const uint8_t *lit, std::size_t count,
+                   uint8_t decay);
+void phosphor_step_scalar(uint8_t *intensity, const uint8_t *lit,
+                          std::size_t count, uint8_t decay);
+
+/**
+ * Scale2x (EPX) on a packed 1-bit frame, done 64 pixels at a time with
+ * bitwise ops. Each output row is two words, left half first.
+ */
+void scale2x_frame(const Frame &frame, uint64_t *out);
@@ -0,0 +1,235 @@
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "chip/chip8.h"
+#include "recorder/recorder.h"
+#include "shared-memory/shared-frame.h"
+#include "stream-server/stream-server.h"
+
+// Runs ROMs without a window or pacing, e.g. to batch capture demo-roms:
+//   ./headless --frames 600 --record-dir out --format gif ../demo-roms/*.ch8
+// With --share, publishes each frame to a shared-memory region for another
+// process to show and takes its keys from there, paced to 60 fps:
+//   ./headless --frames 36000 --share /chip8 ../demo-roms/pong.ch8
+// With --serve, runs --instances copies of one ROM until killed and streams
+// them to clients on a Unix socket path, or a loopback TCP port if it's a
+// number (see stream-server/stream-server.h):
+//   ./headless --serve /tmp/chip8.sock --instances 100 ../demo-roms/pong.ch8
+// With --stop-on-loop, a ROM stops as soon as its state at the end of a
+// frame repeats one seen before, i.e. it's settled into a loop that input
+// would have to break (random draws aside, which the state leaves out):
+//   ./headless --frames 100000 --stop-on-loop ../demo-roms/*.ch8
+// With --trace-dir (in a CHIP8_TRACE build), keeps each ROM's recent
+// execution history and writes it to <dir>/<rom>.trace when the ROM ends
+// or the emulator crashes, for trace_decode to print:
+//   ./headless --frames 600 --trace-dir traces ../demo-roms/pong.ch8
+
+#ifdef CHIP8_TRACE
+namespace {
+// What the crash handler saves: the running ROM's ring and its open file
+const TraceRing *crash_trace = nullptr;
+int crash_fd = -1;
+
+void dump_on_crash(int signal) {
+  if (crash_trace) {
+    crash_trace->dump_to_fd(crash_fd);
+  }
+  std::signal(signal, SIG_DFL);
+  std::raise(signal);
+}
+} // namespace
+#endif
+
+int main(int argc, char *argv[]) {
+  int frames = 600;
+  int cycles_per_frame = DEFAULT_CYCLES_PER_FRAME;
+  std::string record_dir;
+  std::string format = "gif";
+  // fixed by default so captures are reproducible
+  uint64_t seed = 0;
+  std::string share;
+  std::string serve;
+  int instances = 1;
+  bool stop_on_loop = false;
+  bool vip_timing = false;
+  std::string trace_dir;
+  std::vector<std::string> roms;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--frames" && has_value) {
+      frames = std::atoi(argv[++i]);
+    } else if (arg == "--cycles-per-frame" && has_value) {
+      cycles_per_frame = std::atoi(argv[++i]);
+    } else if (arg == "--record-dir" && has_value) {
+      record_dir = argv[++i];
+    } else if (arg == "--format" && has_value) {
+      format = argv[++i];
+    } else if (arg == "--seed" && has_value) {
+      seed = std::strtoull(argv[++i], nullptr, 0);
+    } else if (arg == "--share" && has_value) {
+      share = argv[++i];
+    } else if (arg == "--serve" && has_value) {
+      serve = argv[++i];
+    } else if (arg == "--instances" && has_value) {
+      instances = std::atoi(argv[++i]);
+    } else if (arg == "--stop-on-loop") {
+      stop_on_loop = true;
+    } else if (arg == "--vip-timing") {
+      vip_timing = true;
+    } else if (arg == "--trace-dir" && has_value) {
+      trace_dir = argv[++i];
+    } else if (arg.compare(0, 2, "--") == 0) {
+      roms.clear();
+      break;
+    } else {
+      roms.push_back(arg);
+    }
+  }
+
+  if (roms.empty() || frames <= 0 || cycles_per_frame <= 0 ||
+      instances <= 0 || (!serve.empty() && roms.size() != 1)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--frames <n>] [--cycles-per-frame <n> | --vip-timing]"
+                 " [--seed <n>]"
+                 " [--record-dir <dir> [--format gif|y4m|raw]]"
+                 " [--share </name>] [--stop-on-loop] [--trace-dir <dir>]"
+                 " <ROM>...\n"
+              << "       " << argv[0]
+              << " --serve <socket path|port> [--instances <n>]"
+                 " [--cycles-per-frame <n>] [--seed <n>] <ROM>"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (!serve.empty()) {
+    std::ifstream file(roms[0], std::ios::binary);
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    StreamServer server(rom, instances, cycles_per_frame, seed);
+    bool is_port = serve.find_first_not_of("0123456789") == std::string::npos;
+    if (!file || !(is_port ? server.listen_tcp(std::atoi(serve.c_str()))
+                           : server.listen_unix(serve))) {
+      std::cerr << "Can't serve " << roms[0] << " on " << serve << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    server.run();
+    return 0;
+  }
+
+#ifdef CHIP8_TRACE
+  TraceRing trace;
+  if (!trace_dir.empty()) {
+    for (int signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+      std::signal(signal, dump_on_crash);
+    }
+  }
+#else
+  if (!trace_dir.empty()) {
+    std::cerr << "--trace-dir needs a build with CHIP8_TRACE" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+#endif
+
+  std::unique_ptr<SharedFramePublisher> publisher;
+  if (!share.empty()) {
+    publisher.reset(new SharedFramePublisher(share));
+    if (!publisher->ok()) {
+      std::cerr << "Can't create shared memory " << share << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  for (const std::string &rom : roms) {
+    CHIP8 chip = CHIP8();
+    chip.seed(seed);
+    chip.cycles_per_frame = cycles_per_frame;
+    chip.vip_timing = vip_timing;
+    if (!chip.load_rom(rom)) {
+      std::cerr << "Can't load " << rom << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+
+    std::string name = rom.substr(rom.find_last_of('/') + 1);
+    name = name.substr(0, name.find_last_of('.'));
+
+    std::unique_ptr<Recorder> recorder;
+    if (!record_dir.empty()) {
+      recorder.reset(new Recorder(record_dir + "/" + name + "." + format));
+      if (!recorder->ok()) {
+        std::cerr << "Can't record " << rom << " to " << record_dir
+                  << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    }
+
+#ifdef CHIP8_TRACE
+    if (!trace_dir.empty()) {
+      // opened up front, as the crash handler can't open files
+      std::string path = trace_dir + "/" + name + ".trace";
+      crash_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (crash_fd < 0) {
+        std::cerr << "Can't write " << path << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+      trace.clear();
+      chip.trace = &trace;
+      crash_trace = &trace;
+    }
+#endif
+
+    // state_hash() at the end of each frame, to the first frame it was seen
+    std::unordered_map<uint64_t, int> seen;
+    std::string loop;
+
+    auto next_frame = std::chrono::steady_clock::now();
+    int frame = 0;
+    for (; frame < frames; frame++) {
+      if (publisher) {
+        publisher->apply_keys(chip);
+      }
+      chip.run_frame();
+      if (publisher) {
+        publisher->publish(chip);
+        // someone is watching, so run in real time
+        next_frame += std::chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+        std::this_thread::sleep_until(next_frame);
+      }
+      if (recorder) {
+        // nothing is racing us here, so wait rather than drop
+        recorder->submit_wait(chip.frame_view());
+      }
+      if (stop_on_loop) {
+        auto first = seen.emplace(chip.state_hash(), frame);
+        if (!first.second) {
+          loop = ", looping every " +
+                 std::to_string(frame - first.first->second) +
+                 " frames from frame " + std::to_string(first.first->second);
+          frame++;
+          break;
+        }
+      }
+    }
+    std::cout << rom << ": " << frame << " frames" << loop << std::endl;
+#ifdef CHIP8_TRACE
+    if (crash_trace) {
+      crash_trace = nullptr;
+      trace.dump_to_fd(crash_fd);
+      ::close(crash_fd);
+    }
+#endif
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "../metrics/metrics.h"
+#include "../ring-buffer/spsc-ring.h"
+
+struct KeyEvent {
+  uint64_t timestamp_ns; // steady_clock time the frontend saw the event
+  uint8_t key;           // keypad index, 0x0 - 0xf
+  uint8_t pressed;
+};
+
+/**
+ * Carries keypad events from the frontend thread to the emulation thread.
+ * The frontend pushes as it polls; the emulation thread drains between
+ * cycles, so the core never touches the windowing library and never waits
+ * on it.
+ */
+class InputQueue {
+private:
+  SPSCRing<KeyEvent, 64> events;
+
+public:
+  static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Frontend thread. Returns false if the emulation thread has fallen so far
+  // behind that the queue is full, in which case the event is dropped.
+  bool push(uint8_t key, bool pressed, uint64_t timestamp_ns = now_ns()) {
+    return events.push(KeyEvent{timestamp_ns, key, uint8_t(pressed)});
+  }
+
+  /**
+   * Emulation thread. Applies queued events to the keypad in order and
+   * returns how many were applied.
+   * Draining stops before an event that would undo a key change made earlier
+   * in the same call, so a press and release that arrive between two cycles
+   * are still seen by at least one instruction.
+   * With latency set, records how long each applied event waited since its
+   * timestamp.
+   */
+  template <std::size_t Size>
+  int drain(std::array<uint8_t, Size> &keypad, Histogram *latency = nullptr) {
+    uint16_t changed = 0;
+    int applied = 0;
+    while (const KeyEvent *e = events.peek()) {
+      if (e->key < Size) {
+        if (changed & (1 << e->key)) {
+          break;
+        }
+        keypad[e->key] = e->pressed;
+        changed |= 1 << e->key;
+        applied++;
+        if (latency) {
+          uint64_t now = now_ns();
+          latency->record(now > e->timestamp_ns ? now - e->timestamp_ns : 0);
+        }
+      }
+      KeyEvent consumed;
+      events.pop(consumed);
+    }
+    return applied;
+  }
+
+  bool empty() const { return events.empty(); }
+};
@@ -0,0 +1,61 @@
+#include "instance-pool.h"
+
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+#ifndef CHIP8_PAGED_MEMORY
+// what makes reset() one bulk copy; paged memory shares pages instead
+static_assert(std::is_trivially_copyable<CHIP8>::value,
+              "CHIP8 should copy as plain bytes");
+#endif
+
+int InstancePool::add_rom(const std::string &path, const CHIP8 &configured) {
+  auto found = rom_ids.find(path);
+  if (found != rom_ids.end()) {
+    return found->second;
+  }
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return -1;
+  }
+  std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  return add_rom(path, rom.data(), rom.size(), configured);
+}
+
+int InstancePool::add_rom(const std::string &name, const uint8_t *data,
+                          std::size_t size, const CHIP8 &configured) {
+  auto found = rom_ids.find(name);
+  if (found != rom_ids.end()) {
+    return found->second;
+  }
+  CHIP8 snapshot = configured;
+  if (!snapshot.load_rom(data, size)) {
+    return -1;
+  }
+  snapshots.push_back(snapshot);
+  int id = int(snapshots.size()) - 1;
+  rom_ids[name] = id;
+  return id;
+}
+
+int InstancePool::acquire(int rom) {
+  if (free_slots.empty()) {
+    instances.push_back(snapshots[rom]);
+    slot_roms.push_back(rom);
+    return int(instances.size()) - 1;
+  }
+  int slot = free_slots.back();
+  free_slots.pop_back();
+  slot_roms[slot] = rom;
+  reset(slot);
+  return slot;
+}
+
+void InstancePool::release(int slot) {
+  if (slot_roms[slot] >= 0) {
+    slot_roms[slot] = -1;
+    free_slots.push_back(slot);
+  }
+}
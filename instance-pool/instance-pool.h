@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+/**
+ * Instances for batch workloads that run the same ROMs thousands of times.
+ * Each ROM is loaded once, into a "just loaded" snapshot; acquire() hands
+ * out an instance restored to it and reset() puts one back to it, both by
+ * copying the snapshot over the instance. Outside CHIP8_PAGED_MEMORY a
+ * CHIP8 is trivially copyable (a few KiB, no pointers to chase), so that's
+ * a single bulk copy rather than construction plus file I/O.
+ *
+ * Instances are named by slot and released ones are reused, so a pool
+ * allocates only while it grows. The RNG state is part of the snapshot:
+ * every episode draws the same CXKK bytes unless seeded after a reset.
+ * A pool isn't thread safe; give each thread its own.
+ */
+class InstancePool {
+private:
+  std::deque<CHIP8> snapshots;
+  std::map<std::string, int> rom_ids;
+  // deque, so that references to instances survive the pool growing
+  std::deque<CHIP8> instances;
+  std::vector<int> slot_roms; // -1 when the slot is free
+  std::vector<int> free_slots;
+
+public:
+  /**
+   * Loads a ROM into a new snapshot, or finds the one already loaded from
+   * path, and returns its id; -1 if the file can't be loaded. The ROM is
+   * loaded into a copy of configured, which carries whatever every
+   * instance should start with, e.g. quirks or a seed.
+   */
+  int add_rom(const std::string &path, const CHIP8 &configured = CHIP8());
+  // The same from memory; name only identifies the ROM to add_rom
+  int add_rom(const std::string &name, const uint8_t *data, std::size_t size,
+              const CHIP8 &configured = CHIP8());
+
+  // The snapshot of rom, e.g. to start from a later state instead
+  CHIP8 &snapshot(int rom) { return snapshots[rom]; }
+
+  // A slot holding an instance of rom, freshly reset
+  int acquire(int rom);
+  // Back to the snapshot of its ROM
+  void reset(int slot) { instances[slot] = snapshots[slot_roms[slot]]; }
+  // The slot may be handed out again
+  void release(int slot);
+
+  CHIP8 &instance(int slot) { return instances[slot]; }
+  std::size_t rom_count() const { return snapshots.size(); }
+  std::size_t in_use() const { return instances.size() - free_slots.size(); }
+};
@@ -0,0 +1,449 @@
+#include "lane-engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define LANE_ENGINE_AVX2 1
+#endif
+
+namespace {
+
+void gather_scalar(const uint8_t *base,
+                   const std::array<uint32_t, LANES> &offsets,
+                   std::array<uint8_t, LANES> &out) {
+  for (int lane = 0; lane < LANES; lane++) {
+    out[lane] = base[offsets[lane]];
+  }
+}
+
+#if LANE_ENGINE_AVX2
+// Compiled for AVX2 on its own so the rest of the build keeps the baseline
+// instruction set; only called once the CPU is known to have it
+__attribute__((target("avx2"))) void
+gather_avx2(const uint8_t *base, const std::array<uint32_t, LANES> &offsets,
+            std::array<uint8_t, LANES> &out) {
+  __m256i index = _mm256_loadu_si256((const __m256i *)offsets.data());
+  // 32 bits from each offset, of which the low byte is ours
+  __m256i words =
+      _mm256_i32gather_epi32(reinterpret_cast<const int *>(base), index, 1);
+  __m256i bytes = _mm256_and_si256(words, _mm256_set1_epi32(0xff));
+  __m128i packed16 = _mm_packus_epi32(_mm256_castsi256_si128(bytes),
+                                      _mm256_extracti128_si256(bytes, 1));
+  __m128i packed8 = _mm_packus_epi16(packed16, packed16);
+  _mm_storel_epi64((__m128i *)out.data(), packed8);
+}
+#endif
+
+inline bool selected(LaneMask mask, int lane) { return (mask >> lane) & 1; }
+
+// Runs f(lane) for every lane in mask
+template <typename F> inline void for_lanes(LaneMask mask, F f) {
+  for (int lane = 0; lane < LANES; lane++) {
+    if (selected(mask, lane)) {
+      f(lane);
+    }
+  }
+}
+
+/**
+ * Computes f(lane) for every lane, then keeps the results of the lanes in
+ * mask. Branch-free, so the loops vectorize; f must have no side effects.
+ */
+template <typename T, typename F>
+inline void update(LaneMask mask, std::array<T, LANES> &target, F f) {
+  std::array<T, LANES> result;
+  for (int lane = 0; lane < LANES; lane++) {
+    result[lane] = f(lane);
+  }
+  for (int lane = 0; lane < LANES; lane++) {
+    target[lane] = selected(mask, lane) ? result[lane] : target[lane];
+  }
+}
+
+// Skips the next instruction in the lanes of mask where condition holds
+template <typename F>
+inline void skip_if(LaneMask mask, std::array<uint16_t, LANES> &pc,
+                    F condition) {
+  update(mask, pc, [&](int lane) {
+    return uint16_t(pc[lane] + (condition(lane) ? 2 : 0));
+  });
+}
+
+} // namespace
+
+LaneEngine::LaneEngine() : gather(gather_scalar) {
+#if LANE_ENGINE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    gather = gather_avx2;
+  }
+#endif
+  memory.fill(0);
+  for (auto &reg : registers) {
+    reg.fill(0);
+  }
+  address_i.fill(0);
+  program_counter.fill(START_ADDRESS);
+  for (auto &level : stack) {
+    level.fill(0);
+  }
+  stack_depth.fill(0);
+  delay_timer.fill(0);
+  sound_timer.fill(0);
+  for (auto &key : keypad) {
+    key.fill(0);
+  }
+  for (Frame &screen : screens) {
+    screen.fill(0);
+  }
+  for (int lane = 0; lane < LANES; lane++) {
+    for (unsigned i = 0; i < FONTSET_SIZE; i++) {
+      at(FONTSET_START_ADDRESS + i, lane) = fontset[i];
+    }
+  }
+}
+
+void LaneEngine::load(int lane, const CHIP8 &chip) {
+  for (int address = 0; address < 4096; address++) {
+    at(address, lane) = chip.memory[address];
+  }
+  for (int x = 0; x < 16; x++) {
+    registers[x][lane] = chip.registers[x];
+    keypad[x][lane] = chip.keypad[x];
+  }
+  address_i[lane] = chip.address_i;
+  program_counter[lane] = chip.program_counter;
+  stack_depth[lane] = chip.stack.size();
+  // every level, stale ones too, so a stray 00EE returns to the same place
+  for (int level = 0; level < LANE_STACK_DEPTH; level++) {
+    stack[level][lane] = chip.stack[level];
+  }
+  delay_timer[lane] = chip.delay_timer;
+  sound_timer[lane] = chip.sound_timer;
+  screens[lane] = chip.screen;
+  random[lane] = chip.random;
+}
+
+void LaneEngine::store(int lane, CHIP8 &chip) const {
+  for (int address = 0; address < 4096; address++) {
+    chip.memory[address] = memory[address * LANES + lane];
+  }
+  for (int x = 0; x < 16; x++) {
+    chip.registers[x] = registers[x][lane];
+    chip.keypad[x] = keypad[x][lane];
+  }
+  chip.address_i = address_i[lane];
+  chip.program_counter = program_counter[lane];
+  chip.stack.clear();
+  chip.stack.resize(stack_depth[lane]);
+  for (int level = 0; level < LANE_STACK_DEPTH; level++) {
+    chip.stack[level] = stack[level][lane];
+  }
+  chip.delay_timer = delay_timer[lane];
+  chip.sound_timer = sound_timer[lane];
+  chip.screen = screens[lane];
+  chip.random = random[lane];
+  chip.rehash();
+}
+
+void LaneEngine::fetch(std::array<uint16_t, LANES> &opcodes) const {
+  uint16_t pc = program_counter[0];
+  bool together = std::all_of(program_counter.begin(), program_counter.end(),
+                              [&](uint16_t lane_pc) { return lane_pc == pc; });
+  std::array<uint8_t, LANES> high, low;
+  if (together) {
+    // the same address in every lane is 8 adjacent bytes
+    std::memcpy(high.data(), &memory[(pc & 0xfff) * LANES], LANES);
+    std::memcpy(low.data(), &memory[((pc + 1) & 0xfff) * LANES], LANES);
+  } else {
+    std::array<uint32_t, LANES> offsets;
+    for (int lane = 0; lane < LANES; lane++) {
+      offsets[lane] = (program_counter[lane] & 0xfff) * LANES + lane;
+    }
+    gather(memory.data(), offsets, high);
+    for (int lane = 0; lane < LANES; lane++) {
+      offsets[lane] = ((program_counter[lane] + 1) & 0xfff) * LANES + lane;
+    }
+    gather(memory.data(), offsets, low);
+  }
+  for (int lane = 0; lane < LANES; lane++) {
+    opcodes[lane] = high[lane] << 8 | low[lane];
+  }
+}
+
+void LaneEngine::cycle() {
+  std::array<uint16_t, LANES> opcodes;
+  fetch(opcodes);
+  for (uint16_t &pc : program_counter) {
+    pc += 2;
+  }
+
+  // one pass per distinct opcode, over the lanes that fetched it
+  LaneMask remaining = ALL_LANES;
+  bool first = true;
+  while (remaining) {
+    uint16_t opcode = opcodes[__builtin_ctz(remaining)];
+    LaneMask mask = 0;
+    for (int lane = 0; lane < LANES; lane++) {
+      mask |= LaneMask(opcodes[lane] == opcode) << lane;
+    }
+    mask &= remaining;
+    if (first && mask == ALL_LANES) {
+      converged_cycles++;
+    }
+    first = false;
+    execute(opcode, mask);
+    remaining &= ~mask;
+  }
+  cycles++;
+}
+
+void LaneEngine::step(int count) {
+  for (int i = 0; i < count; i++) {
+    cycle();
+  }
+}
+
+void LaneEngine::tick_timers() {
+  for (int lane = 0; lane < LANES; lane++) {
+    delay_timer[lane] -= delay_timer[lane] > 0;
+    sound_timer[lane] -= sound_timer[lane] > 0;
+  }
+}
+
+void LaneEngine::draw(uint16_t opcode, LaneMask mask) {
+  const auto &vx = registers[(opcode >> 8) & 0xf];
+  const auto &vy = registers[(opcode >> 4) & 0xf];
+  const int height = opcode & 0xf;
+
+  std::array<uint64_t, LANES> collision{};
+  std::array<uint32_t, LANES> offsets;
+  std::array<uint8_t, LANES> rows;
+  for (int row = 0; row < height; row++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      offsets[lane] = ((address_i[lane] + row) & 0xfff) * LANES + lane;
+    }
+    gather(memory.data(), offsets, rows);
+
+    for_lanes(mask, [&](int lane) {
+      int x_pos = vx[lane] % WIDTH;
+      int y = vy[lane] % HEIGHT + row;
+      // clipped at the right and bottom edges, as in CHIP8::draw_sprite
+      if (y >= HEIGHT) {
+        return;
+      }
+      uint64_t data = rows[lane];
+      uint64_t bits = x_pos <= WIDTH - 8 ? data << (WIDTH - 8 - x_pos)
+                                         : data >> (x_pos - (WIDTH - 8));
+      collision[lane] |= screens[lane][y] & bits;
+      screens[lane][y] ^= bits;
+    });
+  }
+  update(mask, registers[0xf],
+         [&](int lane) { return uint8_t(collision[lane] != 0); });
+}
+
+void LaneEngine::execute(uint16_t opcode, LaneMask mask) {
+  const int x = (opcode >> 8) & 0xf;
+  const int y = (opcode >> 4) & 0xf;
+  const uint8_t kk = opcode & 0xff;
+  const uint16_t nnn = opcode & 0xfff;
+  auto &vx = registers[x];
+  auto &vy = registers[y];
+  auto &vf = registers[0xf];
+  auto &pc = program_counter;
+
+  // 8XYn writes the result, then the flag, so with X = F the flag wins
+  auto set_with_flag = [&](const std::array<uint8_t, LANES> &result,
+                           const std::array<uint8_t, LANES> &flag) {
+    update(mask, vx, [&](int lane) { return result[lane]; });
+    update(mask, vf, [&](int lane) { return flag[lane]; });
+  };
+  std::array<uint8_t, LANES> result, flag;
+
+  switch (opcode >> 12) {
+  case 0x0:
+    // decoded on the low nibble only, like CHIP8's table0
+    if ((opcode & 0xf) == 0x0) {
+      for_lanes(mask, [&](int lane) { screens[lane].fill(0); });
+    } else if ((opcode & 0xf) == 0xe) {
+      // as CallStack: an empty stack reads a stale level and stays empty
+      for_lanes(mask, [&](int lane) {
+        int top = (stack_depth[lane] - 1) & (LANE_STACK_DEPTH - 1);
+        pc[lane] = stack[top][lane];
+        stack_depth[lane] -= stack_depth[lane] > 0;
+      });
+    }
+    break;
+  case 0x1:
+    update(mask, pc, [&](int) { return nnn; });
+    break;
+  case 0x2:
+    for_lanes(mask, [&](int lane) {
+      // as CallStack: a call on a full stack drops the oldest level
+      if (stack_depth[lane] == LANE_STACK_DEPTH) {
+        for (int level = 1; level < LANE_STACK_DEPTH; level++) {
+          stack[level - 1][lane] = stack[level][lane];
+        }
+        stack_depth[lane]--;
+      }
+      stack[stack_depth[lane]++][lane] = pc[lane];
+      pc[lane] = nnn;
+    });
+    break;
+  case 0x3:
+    skip_if(mask, pc, [&](int lane) { return vx[lane] == kk; });
+    break;
+  case 0x4:
+    skip_if(mask, pc, [&](int lane) { return vx[lane] != kk; });
+    break;
+  case 0x5:
+    skip_if(mask, pc, [&](int lane) { return vx[lane] == vy[lane]; });
+    break;
+  case 0x6:
+    update(mask, vx, [&](int) { return kk; });
+    break;
+  case 0x7:
+    update(mask, vx, [&](int lane) { return uint8_t(vx[lane] + kk); });
+    break;
+  case 0x8:
+    switch (opcode & 0xf) {
+    case 0x0:
+      update(mask, vx, [&](int lane) { return vy[lane]; });
+      break;
+    case 0x1:
+    case 0x2:
+    case 0x3:
+      for (int lane = 0; lane < LANES; lane++) {
+        int op = opcode & 0xf;
+        result[lane] = op == 1   ? vx[lane] | vy[lane]
+                       : op == 2 ? vx[lane] & vy[lane]
+                                 : vx[lane] ^ vy[lane];
+      }
+      update(mask, vx, [&](int lane) { return result[lane]; });
+      if (quirks.logic_resets_vf) {
+        update(mask, vf, [&](int) { return uint8_t(0); });
+      }
+      break;
+    case 0x4:
+      for (int lane = 0; lane < LANES; lane++) {
+        unsigned sum = vx[lane] + vy[lane];
+        result[lane] = sum;
+        flag[lane] = sum >> 8;
+      }
+      set_with_flag(result, flag);
+      break;
+    case 0x5:
+    case 0x7:
+      for (int lane = 0; lane < LANES; lane++) {
+        bool reverse = (opcode & 0xf) == 0x7;
+        unsigned difference = reverse ? 0x100 + vy[lane] - vx[lane]
+                                      : 0x100 + vx[lane] - vy[lane];
+        result[lane] = difference;
+        flag[lane] = difference >> 8;
+      }
+      set_with_flag(result, flag);
+      break;
+    case 0x6:
+    case 0xe: {
+      const auto &source = quirks.shift_uses_vy ? vy : vx;
+      bool left = (opcode & 0xf) == 0xe;
+      for (int lane = 0; lane < LANES; lane++) {
+        result[lane] = left ? source[lane] << 1 : source[lane] >> 1;
+        flag[lane] = left ? source[lane] >> 7 : source[lane] & 1;
+      }
+      set_with_flag(result, flag);
+      break;
+    }
+    }
+    break;
+  case 0x9:
+    skip_if(mask, pc, [&](int lane) { return vx[lane] != vy[lane]; });
+    break;
+  case 0xa:
+    update(mask, address_i, [&](int) { return nnn; });
+    break;
+  case 0xb:
+    update(mask, pc,
+           [&](int lane) { return uint16_t(registers[0][lane] + nnn); });
+    break;
+  case 0xc:
+    for_lanes(mask,
+              [&](int lane) { vx[lane] = random[lane].next_byte() & kk; });
+    break;
+  case 0xd:
+    draw(opcode, mask);
+    break;
+  case 0xe:
+    // decoded on the low nibble only, like CHIP8's tableE
+    if ((opcode & 0xf) == 0xe) {
+      skip_if(mask, pc,
+              [&](int lane) { return keypad[vx[lane] & 0xf][lane] != 0; });
+    } else if ((opcode & 0xf) == 0x1) {
+      skip_if(mask, pc,
+              [&](int lane) { return keypad[vx[lane] & 0xf][lane] == 0; });
+    }
+    break;
+  case 0xf:
+    switch (kk) {
+    case 0x07:
+      update(mask, vx, [&](int lane) { return delay_timer[lane]; });
+      break;
+    case 0x0a:
+      for_lanes(mask, [&](int lane) {
+        for (int key = 0; key < 16; key++) {
+          if (keypad[key][lane]) {
+            vx[lane] = key;
+            return;
+          }
+        }
+        pc[lane] -= 2; // wait here until a key is down
+      });
+      break;
+    case 0x15:
+      update(mask, delay_timer, [&](int lane) { return vx[lane]; });
+      break;
+    case 0x18:
+      update(mask, sound_timer, [&](int lane) { return vx[lane]; });
+      break;
+    case 0x1e:
+      update(mask, address_i,
+             [&](int lane) { return uint16_t(address_i[lane] + vx[lane]); });
+      break;
+    case 0x29:
+      update(mask, address_i, [&](int lane) {
+        return uint16_t(FONTSET_START_ADDRESS + vx[lane] * 5);
+      });
+      break;
+    case 0x33:
+      for_lanes(mask, [&](int lane) {
+        uint8_t value = vx[lane];
+        at(address_i[lane] + 2, lane) = value % 10;
+        at(address_i[lane] + 1, lane) = value / 10 % 10;
+        at(address_i[lane], lane) = value / 100;
+      });
+      break;
+    case 0x55:
+      for_lanes(mask, [&](int lane) {
+        for (int i = 0; i <= x; i++) {
+          at(address_i[lane] + i, lane) = registers[i][lane];
+        }
+      });
+      break;
+    case 0x65: {
+      std::array<uint32_t, LANES> offsets;
+      std::array<uint8_t, LANES> values;
+      for (int i = 0; i <= x; i++) {
+        for (int lane = 0; lane < LANES; lane++) {
+          offsets[lane] = ((address_i[lane] + i) & 0xfff) * LANES + lane;
+        }
+        gather(memory.data(), offsets, values);
+        update(mask, registers[i], [&](int lane) { return values[lane]; });
+      }
+      break;
+    }
+    }
+    break;
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "../chip/chip8.h"
+
+// Machines per engine: one AVX2 gather of 32-bit lanes
+const int LANES = 8;
+
+// Bit n selects lane n
+typedef uint8_t LaneMask;
+const LaneMask ALL_LANES = 0xff;
+
+// The same as CHIP8's, which load() and store() rely on
+const int LANE_STACK_DEPTH = CALL_STACK_DEPTH;
+
+/**
+ * Experimental: interprets LANES machines at once, for batches running the
+ * same ROM. State is stored structure-of-arrays, lane innermost, so the
+ * same register or address across all lanes is LANES adjacent bytes.
+ *
+ * Each cycle fetches every lane's opcode (one 8-byte load when the PCs
+ * agree, AVX2 gathers when they don't), then executes each distinct opcode
+ * once for the mask of lanes that fetched it. While the machines stay in
+ * step that is a single pass whose per-lane loops the compiler vectorizes;
+ * once they diverge it degrades gracefully to one pass per distinct opcode,
+ * down to plain per-lane execution.
+ *
+ * Behaves exactly like CHIP8::cycle() for programs that stay in bounds;
+ * out-of-range addresses wrap at 4 KiB here where CHIP8 would misbehave.
+ */
+class LaneEngine {
+private:
+  typedef void (*GatherFunc)(const uint8_t *base,
+                             const std::array<uint32_t, LANES> &offsets,
+                             std::array<uint8_t, LANES> &out);
+  GatherFunc gather;
+
+  void fetch(std::array<uint16_t, LANES> &opcodes) const;
+  void execute(uint16_t opcode, LaneMask mask);
+  void draw(uint16_t opcode, LaneMask mask);
+
+  inline uint8_t &at(uint16_t address, int lane) {
+    return memory[(address & 0xfff) * LANES + lane];
+  }
+
+public:
+  // memory[address * LANES + lane], plus slack for 32-bit gathers at the end
+  std::array<uint8_t, 4096 * LANES + 4> memory;
+  // registers[x][lane]
+  std::array<std::array<uint8_t, LANES>, 16> registers;
+  std::array<uint16_t, LANES> address_i;
+  std::array<uint16_t, LANES> program_counter;
+  std::array<std::array<uint16_t, LANES>, LANE_STACK_DEPTH> stack;
+  std::array<uint8_t, LANES> stack_depth;
+  std::array<uint8_t, LANES> delay_timer;
+  std::array<uint8_t, LANES> sound_timer;
+  // keypad[key][lane]
+  std::array<std::array<uint8_t, LANES>, 16> keypad;
+  std::array<Frame, LANES> screens;
+  std::array<FastRandom, LANES> random;
+  Quirks quirks;
+
+  // How often all lanes ran one opcode together, against all cycles
+  uint64_t cycles = 0;
+  uint64_t converged_cycles = 0;
+
+  // Uses AVX2 gathers when the CPU has them
+  LaneEngine();
+
+  // Copies a whole machine into or out of a lane
+  void load(int lane, const CHIP8 &chip);
+  void store(int lane, CHIP8 &chip) const;
+
+  // One instruction on every lane
+  void cycle();
+  void step(int cycles);
+  void tick_timers();
+};
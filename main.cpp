@@ -1,39 +1,137 @@
 #include <chrono>
 #include <iostream>
 
+#include "audio/audio.h"
 #include "chip/chip8.h"
+#include "emu-thread/emu-thread.h"
+#include "input-queue/input-queue.h"
+#include "metrics/metrics.h"
+#include "options/options.h"
+#include "playlist/playlist.h"
+#include "recorder/recorder.h"
+#include "sdl-window/sdl-audio.h"
 #include "sdl-window/sdl-window.h"
+#include "triple-buffer/triple-buffer.h"
+
+const double SLOW_MOTION_SPEED = 0.25;
+// How often --metrics rewrites its file
+const std::chrono::seconds METRICS_INTERVAL(1);
 
 int main(int argc, char *argv[]) {
-  if (argc != 4) {
-    std::cerr << "Usage: " << argv[0] << " <scale> <delay> <ROM>" << std::endl;
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  CHIP8 configured = CHIP8();
+  if (options.vip_quirks) {
+    configured.quirks = Quirks::cosmac_vip();
+  }
+  configured.vip_timing = options.vip_timing;
+  // the rest of the playlist loads in the background while this one runs
+  Playlist playlist(options.playlist, configured);
+  const CHIP8 *first = playlist.select(0);
+  if (!first) {
+    std::cerr << "Can't load " << options.rom << std::endl;
     std::exit(EXIT_FAILURE);
   }
+  CHIP8 chip = *first;
+
+  SDLWindow sdl_window("CHIP8 Emulator", options.video_scale);
+  if (playlist.size() > 1) {
+    sdl_window.set_title("CHIP8 Emulator: " + options.rom);
+  }
+  if (options.filter()) {
+    sdl_window.enable_filter(options.phosphor, options.scale2x,
+                             options.scanlines);
+  }
+  sdl_window.update(chip.frame_view());
+
+  SDLAudio sdl_audio;
+  AudioStream audio(sdl_audio);
+
+  std::unique_ptr<Recorder> recorder;
+  if (!options.record.empty()) {
+    recorder.reset(new Recorder(options.record));
+    if (!recorder->ok()) {
+      std::cerr << "Can't record to " << options.record << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
 
-  int video_scale = std::stoi(argv[1]);
-  int cycle_delay = std::stoi(argv[2]);
-  const std::string rom_filename = argv[3];
+  InputQueue input;
+  TripleBuffer<Frame> frames;
 
-  CHIP8 chip = CHIP8();
-  chip.load_rom(rom_filename);
+  // One instruction every cycle_delay ms, as before, grouped into 60 Hz frames
+  double cycles_per_frame = 1000.0 / options.cycle_delay / FRAMES_PER_SECOND;
+  EmulatorThread emulator(chip, input, frames, cycles_per_frame, &audio,
+                          options.turbo_frameskip);
+  emulator.set_turbo(options.turbo);
+  emulator.set_speed(options.speed);
+  emulator.set_recorder(recorder.get());
 
-  SDLWindow sdl_window = SDLWindow("CHIP8 Emulator", video_scale);
-  sdl_window.update(chip.screen);
+  Metrics metrics;
+  bool measure = !options.metrics.empty();
+  if (measure) {
+    emulator.set_metrics(&metrics);
+  }
+  auto next_metrics = std::chrono::steady_clock::now() + METRICS_INTERVAL;
+  const std::chrono::seconds playlist_interval(options.playlist_seconds);
+  auto next_rom = std::chrono::steady_clock::now() + playlist_interval;
 
-  auto last_cycle_time = std::chrono::high_resolution_clock::now();
   bool quit = false;
   while (!quit) {
-    quit = sdl_window.process_input(chip.keypad);
+    Hotkeys hotkeys;
+    quit = sdl_window.process_input(input, hotkeys);
+    if (hotkeys.turbo) {
+      emulator.set_turbo(!emulator.is_turbo());
+    }
+    if (hotkeys.slow_motion) {
+      emulator.set_speed(emulator.get_speed() == SLOW_MOTION_SPEED
+                             ? options.speed
+                             : SLOW_MOTION_SPEED);
+    }
+    bool advance = options.playlist_seconds > 0 &&
+                   std::chrono::steady_clock::now() >= next_rom;
+    if (playlist.size() > 1 &&
+        (hotkeys.next_rom || hotkeys.previous_rom || advance)) {
+      // unloadable entries are skipped, so there's always one to go to
+      const CHIP8 *next =
+          hotkeys.previous_rom ? playlist.previous() : playlist.next();
+      emulator.load(*next);
+      sdl_window.set_title("CHIP8 Emulator: " +
+                           playlist.path(playlist.position()));
+      next_rom = std::chrono::steady_clock::now() + playlist_interval;
+    }
 
-    auto current_time = std::chrono::high_resolution_clock::now();
-    float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(
-                   current_time - last_cycle_time)
-                   .count();
+    if (frames.acquire()) {
+      // blocks until vsync, which paces this loop
+      auto update_start = std::chrono::steady_clock::now();
+      sdl_window.update(frames.read_buffer());
+      if (measure) {
+        metrics.presented.add(1);
+        metrics.update_ns.record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - update_start)
+                .count());
+      }
+    } else {
+      SDL_Delay(1);
+    }
 
-    if (dt > cycle_delay) {
-      last_cycle_time = current_time;
-      chip.cycle();
-      sdl_window.update(chip.screen);
+    if (measure && std::chrono::steady_clock::now() >= next_metrics) {
+      write_metrics_file(metrics, options.metrics);
+      next_metrics += METRICS_INTERVAL;
     }
   }
-}
\ No newline at end of file
+
+  emulator.stop();
+  if (measure && !write_metrics_file(metrics, options.metrics)) {
+    std::cerr << "Can't write metrics to " << options.metrics << std::endl;
+  }
+  if (recorder && recorder->dropped_frames() > 0) {
+    std::cerr << "Recording dropped " << recorder->dropped_frames()
+              << " frames" << std::endl;
+  }
+}
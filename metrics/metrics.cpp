@@ -0,0 +1,124 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+double per_second(uint64_t count, double seconds) {
+  return seconds > 0 ? count / seconds : 0;
+}
+
+void write_histogram(const Histogram &histogram, std::ostream &out) {
+  out << "{\"count\": " << histogram.count()
+      << ", \"mean\": " << histogram.mean()
+      << ", \"p50\": " << histogram.percentile(0.5)
+      << ", \"p90\": " << histogram.percentile(0.9)
+      << ", \"p99\": " << histogram.percentile(0.99)
+      << ", \"p999\": " << histogram.percentile(0.999)
+      << ", \"max\": " << histogram.max() << "}";
+}
+
+} // namespace
+
+int Histogram::bucket(uint64_t value) {
+  if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+    return int(value);
+  }
+  value = std::min<uint64_t>(value, (1ull << HISTOGRAM_MAX_BITS) - 1);
+  // keep the top 5 bits: a leading 1 and the sub-bucket
+  int shift = 63 - __builtin_clzll(value) - 4;
+  return shift * HISTOGRAM_SUB_BUCKETS + int(value >> shift);
+}
+
+uint64_t Histogram::bucket_floor(int index) {
+  if (index < 2 * HISTOGRAM_SUB_BUCKETS) {
+    return index;
+  }
+  int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+  return uint64_t(index % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS)
+         << shift;
+}
+
+void Histogram::record(uint64_t value) {
+  std::atomic<uint64_t> &count = buckets[bucket(value)];
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+  total.add(1);
+  sum.add(value);
+  if (value > largest.load(std::memory_order_relaxed)) {
+    largest.store(value, std::memory_order_relaxed);
+  }
+}
+
+double Histogram::mean() const {
+  uint64_t n = count();
+  return n ? double(sum.get()) / n : 0;
+}
+
+uint64_t Histogram::percentile(double q) const {
+  // buckets are read one at a time while the writer goes on, so count
+  // them rather than trusting total
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t n = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    n += counts[i];
+  }
+  if (n == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max<uint64_t>(1, uint64_t(q * n + 0.5));
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint64_t top = i + 1 < HISTOGRAM_BUCKETS ? bucket_floor(i + 1) - 1
+                                               : UINT64_MAX;
+      return std::min(top, max());
+    }
+  }
+  return max();
+}
+
+void write_metrics_json(const Metrics &metrics, std::ostream &out) {
+  double seconds = seconds_since(metrics.start);
+  out << "{\"seconds\": " << seconds << ",\n"
+      << " \"instructions\": " << metrics.instructions.get() << ",\n"
+      << " \"instructions_per_second\": "
+      << per_second(metrics.instructions.get(), seconds) << ",\n"
+      << " \"frames\": " << metrics.frames.get() << ",\n"
+      << " \"emulated_fps\": " << per_second(metrics.frames.get(), seconds)
+      << ",\n"
+      << " \"presented_fps\": "
+      << per_second(metrics.presented.get(), seconds) << ",\n"
+      << " \"idle_fraction\": "
+      << (seconds > 0 ? metrics.idle_ns.get() / (seconds * 1e9) : 0)
+      << ",\n"
+      << " \"frame_ns\": ";
+  write_histogram(metrics.frame_ns, out);
+  out << ",\n \"update_ns\": ";
+  write_histogram(metrics.update_ns, out);
+  out << ",\n \"input_latency_ns\": ";
+  write_histogram(metrics.input_latency_ns, out);
+  out << "}\n";
+}
+
+bool write_metrics_file(const Metrics &metrics, const std::string &path) {
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary);
+    write_metrics_json(metrics, out);
+    if (!out) {
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * Live counters for the frontend and the emulator thread. Each counter and
+ * histogram has a single writer thread, which bumps it with a relaxed load
+ * and store rather than a locked read-modify-write, so recording costs
+ * about as much as a plain increment. Any thread can read them, e.g. to
+ * export a snapshot, and sees values at most a moment old.
+ */
+class Counter {
+private:
+  std::atomic<uint64_t> value{0};
+
+public:
+  // Writer thread only
+  inline void add(uint64_t n) {
+    value.store(value.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+  }
+  inline uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Linear sub-buckets per power of two, i.e. values are kept to within 1/16
+const int HISTOGRAM_SUB_BUCKETS = 16;
+// Values from 2^40 (about 18 minutes in ns) on share the last bucket
+const int HISTOGRAM_MAX_BITS = 40;
+const int HISTOGRAM_BUCKETS =
+    (HISTOGRAM_MAX_BITS - 4 + 1) * HISTOGRAM_SUB_BUCKETS;
+
+/**
+ * HDR-style histogram: values below 2 * HISTOGRAM_SUB_BUCKETS have a bucket
+ * each, and above that every power of two is split into
+ * HISTOGRAM_SUB_BUCKETS equal buckets, so precision is relative and memory
+ * fixed. Single writer, like Counter.
+ */
+class Histogram {
+private:
+  std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+  Counter total;
+  Counter sum;
+  std::atomic<uint64_t> largest{0};
+
+public:
+  static int bucket(uint64_t value);
+  // The smallest value that falls in bucket index
+  static uint64_t bucket_floor(int index);
+
+  // Writer thread only
+  void record(uint64_t value);
+
+  uint64_t count() const { return total.get(); }
+  uint64_t max() const { return largest.load(std::memory_order_relaxed); }
+  double mean() const;
+  // The largest value in the bucket where fraction q of the records have
+  // been counted, or 0 if there are none
+  uint64_t percentile(double q) const;
+};
+
+/**
+ * What the windowed frontend measures, grouped by the thread that writes
+ * it. Durations are in nanoseconds; rates are worked out on export, over
+ * the time since start.
+ */
+struct Metrics {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  // Emulator thread
+  Counter instructions;
+  Counter frames;
+  // Sleeping until the next frame is due
+  Counter idle_ns;
+  // Running one frame, from its first instruction to publishing it
+  Histogram frame_ns;
+  // From the frontend seeing a key event to the keypad changing
+  Histogram input_latency_ns;
+
+  // Frontend thread
+  Counter presented;
+  // SDLWindow::update, including the wait for vsync
+  Histogram update_ns;
+};
+
+// A snapshot of metrics as one JSON object
+void write_metrics_json(const Metrics &metrics, std::ostream &out);
+
+// The snapshot written to path.tmp and renamed over path, so that a reader
+// polling path never sees half of one
+bool write_metrics_file(const Metrics &metrics, const std::string &path);
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Options {
+  int video_scale = 10;
+  int cycle_delay = 2;
+  std::string rom;
+  // every ROM given, rom being the first; Page Up/Down switch between them
+  std::vector<std::string> playlist;
+  // move on to the next ROM this often if set
+  int playlist_seconds = 0;
+  // start in fast forward
+  bool turbo = false;
+  // in turbo, only every Nth frame is handed to the renderer
+  int turbo_frameskip = 10;
+  // emulation speed multiplier outside of turbo, e.g. 0.5 for half speed
+  double speed = 1.0;
+  // capture to .gif, .y4m or .raw if set
+  std::string record;
+  // software post-processing; any of these turns the filter on
+  double phosphor = 0;
+  bool scanlines = false;
+  bool scale2x = false;
+  // original COSMAC VIP behaviour for the ops interpreters disagree on
+  bool vip_quirks = false;
+  // VIP instruction timing instead of the cycle delay
+  bool vip_timing = false;
+  // rewrite a JSON snapshot of metrics/metrics.h here every second if set
+  std::string metrics;
+
+  bool filter() const { return phosphor > 0 || scanlines || scale2x; }
+};
+
+inline void print_usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [options] <scale> <delay> <ROM> [<ROM>...]\n"
+            << "  --turbo          start in fast forward (toggle with Tab)\n"
+            << "  --frameskip <n>  frames per rendered frame in turbo\n"
+            << "  --speed <x>      speed multiplier, e.g. 0.25 for slow "
+               "motion (toggle with Backspace)\n"
+            << "  --record <file>  capture gameplay to a .gif, .y4m or .raw\n"
+            << "  --phosphor <x>   fade pixels out over frames, keeping x "
+               "(0-1) per frame\n"
+            << "  --scanlines      darken every pixel row's last line\n"
+            << "  --scale2x        smooth edges with Scale2x\n"
+            << "  --vip            use original COSMAC VIP quirks\n"
+            << "  --vip-timing     run at COSMAC VIP speed, ignoring delay\n"
+            << "  --metrics <file> keep a JSON snapshot of speed, frame "
+               "times and input latency\n"
+            << "  --playlist-seconds <n>  with several ROMs, switch to the "
+               "next every n seconds\n"
+            << "Several ROMs make a playlist: Page Down and Page Up switch "
+               "between them."
+            << std::endl;
+}
+
+/**
+ * Parses the command line into options.
+ * Returns false, after printing what was wrong, if the arguments don't make
+ * sense.
+ */
+inline bool parse_options(int argc, char *argv[], Options &options) {
+  std::vector<std::string> positional;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (arg == "--turbo") {
+      options.turbo = true;
+    } else if (arg == "--frameskip" && has_value) {
+      options.turbo_frameskip = std::atoi(argv[++i]);
+    } else if (arg == "--speed" && has_value) {
+      options.speed = std::atof(argv[++i]);
+    } else if (arg == "--record" && has_value) {
+      options.record = argv[++i];
+    } else if (arg == "--phosphor" && has_value) {
+      options.phosphor = std::atof(argv[++i]);
+    } else if (arg == "--scanlines") {
+      options.scanlines = true;
+    } else if (arg == "--scale2x") {
+      options.scale2x = true;
+    } else if (arg == "--vip") {
+      options.vip_quirks = true;
+    } else if (arg == "--vip-timing") {
+      options.vip_timing = true;
+    } else if (arg == "--metrics" && has_value) {
+      options.metrics = argv[++i];
+    } else if (arg == "--playlist-seconds" && has_value) {
+      options.playlist_seconds = std::atoi(argv[++i]);
+    } else if (arg.compare(0, 2, "--") == 0) {
+      std::cerr << "Unknown or incomplete option " << arg << std::endl;
+      return false;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+
+  if (positional.size() < 3) {
+    return false;
+  }
+  options.video_scale = std::atoi(positional[0].c_str());
+  options.cycle_delay = std::atoi(positional[1].c_str());
+  options.rom = positional[2];
+  options.playlist.assign(positional.begin() + 2, positional.end());
+
+  if (options.video_scale <= 0 || options.cycle_delay <= 0) {
+    std::cerr << "Scale and delay must be at least 1" << std::endl;
+    return false;
+  }
+  if (options.phosphor < 0 || options.phosphor >= 1) {
+    std::cerr << "Phosphor decay must be between 0 and 1" << std::endl;
+    return false;
+  }
+  if (options.turbo_frameskip <= 0 || options.speed <= 0) {
+    std::cerr << "Frameskip and speed must be positive" << std::endl;
+    return false;
+  }
+  if (options.playlist_seconds < 0) {
+    std::cerr << "Playlist seconds can't be negative" << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+const std::size_t MEMORY_SIZE = 4096;
+const std::size_t MEMORY_PAGE_SIZE = 256;
+const std::size_t MEMORY_PAGES = MEMORY_SIZE / MEMORY_PAGE_SIZE;
+
+/**
+ * CHIP-8 memory as 16 reference-counted 256-byte pages, copied on write.
+ * Copying a PagedMemory copies 16 pointers, so instances made from one
+ * loaded ROM share its font and code pages, and a snapshot costs nothing
+ * until one side writes. Only the pages FX33/FX55 (or a debugger) write to
+ * are ever duplicated; untouched pages all point at one shared zero page.
+ *
+ * Reads go through the const operator[]. The non-const one hands out a
+ * Reference, so reading through it doesn't copy anything either; only
+ * assigning to it does. Copies are safe to use from different threads,
+ * as with any value type, but one PagedMemory is not.
+ */
+class PagedMemory {
+private:
+  struct Page {
+    std::atomic<int> owners;
+    std::array<uint8_t, MEMORY_PAGE_SIZE> bytes;
+  };
+
+  std::array<Page *, MEMORY_PAGES> pages;
+
+  // Never freed: starts with an owner nobody releases
+  static Page *zero_page() {
+    static Page zeros{{1}, {}};
+    return &zeros;
+  }
+
+  static Page *share(Page *page) {
+    page->owners.fetch_add(1, std::memory_order_relaxed);
+    return page;
+  }
+
+  static void release(Page *page) {
+    if (page->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete page;
+    }
+  }
+
+  void release_all() {
+    for (Page *page : pages) {
+      release(page);
+    }
+  }
+
+  // The page at index, made private first if anything else shares it
+  uint8_t *writable(std::size_t index) {
+    Page *&page = pages[index];
+    // acquire: other owners' last reads happen before our writes
+    if (page->owners.load(std::memory_order_acquire) != 1) {
+      Page *copy = new Page{{1}, page->bytes};
+      release(page);
+      page = copy;
+    }
+    return page->bytes.data();
+  }
+
+public:
+  class Reference {
+  private:
+    PagedMemory &memory;
+    std::size_t address;
+
+  public:
+    Reference(PagedMemory &memory, std::size_t address)
+        : memory(memory), address(address) {}
+
+    operator uint8_t() const {
+      return static_cast<const PagedMemory &>(memory)[address];
+    }
+    Reference &operator=(uint8_t value) {
+      memory.writable(address / MEMORY_PAGE_SIZE)[address % MEMORY_PAGE_SIZE] =
+          value;
+      return *this;
+    }
+    Reference &operator=(const Reference &other) {
+      return *this = uint8_t(other);
+    }
+  };
+
+  PagedMemory() {
+    for (Page *&page : pages) {
+      page = share(zero_page());
+    }
+  }
+
+  PagedMemory(const PagedMemory &other) {
+    for (std::size_t i = 0; i < MEMORY_PAGES; i++) {
+      pages[i] = share(other.pages[i]);
+    }
+  }
+
+  PagedMemory &operator=(const PagedMemory &other) {
+    // share first, so self-assignment never drops the last owner
+    for (Page *page : other.pages) {
+      share(page);
+    }
+    release_all();
+    pages = other.pages;
+    return *this;
+  }
+
+  ~PagedMemory() { release_all(); }
+
+  inline uint8_t operator[](std::size_t address) const {
+    return pages[address / MEMORY_PAGE_SIZE]
+        ->bytes[address % MEMORY_PAGE_SIZE];
+  }
+  inline Reference operator[](std::size_t address) {
+    return Reference(*this, address);
+  }
+
+  std::size_t size() const { return MEMORY_SIZE; }
+
+  void fill(uint8_t value) {
+    for (std::size_t i = 0; i < MEMORY_PAGES; i++) {
+      if (value == 0) {
+        release(pages[i]);
+        pages[i] = share(zero_page());
+      } else {
+        writable(i);
+        pages[i]->bytes.fill(value);
+      }
+    }
+  }
+
+  // MEMORY_PAGE_SIZE contiguous bytes
+  const uint8_t *page(std::size_t index) const {
+    return pages[index]->bytes.data();
+  }
+
+  // Whether both hold the same page, not just equal bytes
+  bool shares_page(const PagedMemory &other, std::size_t index) const {
+    return pages[index] == other.pages[index];
+  }
+
+  // Pages this copy holds privately, i.e. what it costs beyond the pointers
+  std::size_t private_pages() const {
+    std::size_t count = 0;
+    for (Page *page : pages) {
+      count += page->owners.load(std::memory_order_relaxed) == 1;
+    }
+    return count;
+  }
+};
+
+// Page access that works for both memory models CHIP8 can be built with
+inline const uint8_t *memory_page(const PagedMemory &memory,
+                                  std::size_t index) {
+  return memory.page(index);
+}
+inline const uint8_t *
+memory_page(const std::array<uint8_t, MEMORY_SIZE> &memory, std::size_t index) {
+  return memory.data() + index * MEMORY_PAGE_SIZE;
+}
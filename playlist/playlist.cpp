@@ -0,0 +1,68 @@
+#include "playlist.h"
+
+Playlist::Playlist(const std::vector<std::string> &paths,
+                   const CHIP8 &configured)
+    : configured(configured), entries(paths.size()) {
+  for (std::size_t i = 0; i < paths.size(); i++) {
+    entries[i].path = paths[i];
+  }
+  // entries is never resized after this, so the thread can hold on to them
+  thread = std::thread(&Playlist::preload, this);
+}
+
+Playlist::~Playlist() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  thread.join();
+}
+
+void Playlist::preload() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (running) {
+    // the first entry not loaded yet, counting on from the current one
+    std::size_t index = entries.size();
+    for (std::size_t offset = 0; offset < entries.size(); offset++) {
+      std::size_t i = (current + offset) % entries.size();
+      if (!entries[i].done) {
+        index = i;
+        break;
+      }
+    }
+    if (index == entries.size()) {
+      return;
+    }
+
+    std::string path = entries[index].path;
+    lock.unlock();
+    std::unique_ptr<CHIP8> snapshot(new CHIP8(configured));
+    if (!snapshot->load_rom(path)) {
+      snapshot.reset();
+    }
+    lock.lock();
+    entries[index].snapshot = std::move(snapshot);
+    entries[index].done = true;
+    loaded.notify_all();
+  }
+}
+
+const CHIP8 *Playlist::select(std::size_t index) {
+  if (index >= entries.size()) {
+    return nullptr;
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  // preload() picks the new position up with its next entry
+  current = index;
+  loaded.wait(lock, [&] { return entries[index].done; });
+  return entries[index].snapshot.get();
+}
+
+const CHIP8 *Playlist::step(std::size_t offset) {
+  for (std::size_t tries = 0; tries < entries.size(); tries++) {
+    if (const CHIP8 *chip = select((current + offset) % entries.size())) {
+      return chip;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+/**
+ * The ROMs a kiosk cycles through. A background thread loads each into a
+ * "just loaded" snapshot ahead of time, nearest after the current entry
+ * first, so switching is a copy of a ready CHIP8 instead of file I/O on
+ * the frontend thread. Snapshots are kept (a few KiB each), so going back
+ * is as quick as going forward.
+ *
+ * Entries are loaded into copies of configured, which carries what every
+ * ROM should start with, e.g. quirks or VIP timing. A Playlist is used
+ * from one thread; only the preloading runs on another.
+ */
+class Playlist {
+private:
+  struct Entry {
+    std::string path;
+    std::unique_ptr<CHIP8> snapshot; // null if the ROM can't be loaded
+    bool done = false;
+  };
+
+  CHIP8 configured;
+  std::vector<Entry> entries;
+  std::size_t current = 0;
+  std::mutex mutex;
+  std::condition_variable loaded;
+  bool running = true;
+  std::thread thread;
+
+  void preload();
+  const CHIP8 *step(std::size_t offset);
+
+public:
+  explicit Playlist(const std::vector<std::string> &paths,
+                    const CHIP8 &configured = CHIP8());
+  ~Playlist();
+
+  Playlist(const Playlist &) = delete;
+  Playlist &operator=(const Playlist &) = delete;
+
+  /**
+   * Makes index the current entry and returns its snapshot, waiting if it
+   * hasn't been loaded yet; nullptr if it can't be loaded. The snapshot
+   * lives as long as the playlist.
+   */
+  const CHIP8 *select(std::size_t index);
+  // The next or previous entry that loads, wrapping around
+  const CHIP8 *next() { return step(1); }
+  const CHIP8 *previous() { return step(entries.size() - 1); }
+
+  std::size_t size() const { return entries.size(); }
+  std::size_t position() const { return current; }
+  const std::string &path(std::size_t index) const {
+    return entries[index].path;
+  }
+};
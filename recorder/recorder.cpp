@@ -0,0 +1,334 @@
+#include "recorder.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+
+// ---- raw ----
+
+void RawEncoder::encode(const Frame &frame) {
+  std::array<char, HEIGHT * 8> bytes;
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int i = 0; i < 8; i++) {
+      bytes[y * 8 + i] = (char)(frame[y] >> (56 - 8 * i));
+    }
+  }
+  out.write(bytes.data(), bytes.size());
+}
+
+void RawEncoder::finish() { out.flush(); }
+
+// ---- y4m ----
+
+Y4MEncoder::Y4MEncoder(std::ostream &out, int scale)
+    : out(out), scale(scale), started(false), previous(),
+      image(WIDTH * scale * HEIGHT * scale, 0) {}
+
+void Y4MEncoder::encode(const Frame &frame) {
+  const int width = WIDTH * scale;
+  if (!started) {
+    out << "YUV4MPEG2 W" << width << " H" << HEIGHT * scale
+        << " F60:1 Ip A1:1 Cmono\n";
+    started = true;
+  }
+
+  for (int y = 0; y < HEIGHT; y++) {
+    if (frame[y] == previous[y]) {
+      continue;
+    }
+    uint8_t *row = &image[y * scale * width];
+    for (int x = 0; x < WIDTH; x++) {
+      uint8_t luma = (frame[y] >> (WIDTH - 1 - x)) & 1 ? 255 : 0;
+      std::fill(row + x * scale, row + (x + 1) * scale, luma);
+    }
+    for (int line = 1; line < scale; line++) {
+      std::copy(row, row + width, row + line * width);
+    }
+  }
+  previous = frame;
+
+  out << "FRAME\n";
+  out.write((const char *)image.data(), image.size());
+}
+
+void Y4MEncoder::finish() { out.flush(); }
+
+// ---- gif ----
+
+namespace {
+
+void put_word(std::ostream &out, int value) {
+  out.put((char)(value & 0xff));
+  out.put((char)((value >> 8) & 0xff));
+}
+
+// Packs variable width LZW codes LSB first into 255 byte GIF sub-blocks
+class CodeWriter {
+private:
+  std::ostream &out;
+  uint32_t bits;
+  int bit_count;
+  std::array<char, 255> block;
+  std::size_t block_size;
+
+  void put_byte(uint8_t byte) {
+    block[block_size++] = (char)byte;
+    if (block_size == block.size()) {
+      flush_block();
+    }
+  }
+
+  void flush_block() {
+    if (block_size > 0) {
+      out.put((char)block_size);
+      out.write(block.data(), block_size);
+      block_size = 0;
+    }
+  }
+
+public:
+  explicit CodeWriter(std::ostream &out)
+      : out(out), bits(0), bit_count(0), block_size(0) {}
+
+  void write(int code, int width) {
+    bits |= (uint32_t)code << bit_count;
+    bit_count += width;
+    while (bit_count >= 8) {
+      put_byte(bits & 0xff);
+      bits >>= 8;
+      bit_count -= 8;
+    }
+  }
+
+  void finish() {
+    if (bit_count > 0) {
+      put_byte(bits & 0xff);
+    }
+    flush_block();
+    out.put(0); // block terminator
+  }
+};
+
+/**
+ * GIF flavored LZW over 1-bit pixels. GIF requires a minimum code size of 2,
+ * so the alphabet is 4 symbols of which only 0 and 1 are used, and the
+ * dictionary is a flat prefix * 4 + symbol table.
+ */
+void write_lzw(std::ostream &out, const std::vector<uint8_t> &pixels) {
+  const int MIN_CODE_SIZE = 2;
+  const int CLEAR = 1 << MIN_CODE_SIZE;
+  const int END = CLEAR + 1;
+  const int MAX_CODE = 4095;
+
+  out.put(MIN_CODE_SIZE);
+  CodeWriter writer(out);
+
+  std::vector<uint16_t> dictionary((MAX_CODE + 1) * 4, 0);
+  int width = MIN_CODE_SIZE + 1;
+  int last_code = END;
+
+  writer.write(CLEAR, width);
+  int prefix = pixels[0];
+  for (std::size_t i = 1; i < pixels.size(); i++) {
+    int key = prefix * 4 + pixels[i];
+    if (dictionary[key]) {
+      prefix = dictionary[key];
+      continue;
+    }
+
+    writer.write(prefix, width);
+    dictionary[key] = ++last_code;
+    if (last_code >= (1 << width)) {
+      width++;
+    }
+    if (last_code == MAX_CODE) {
+      writer.write(CLEAR, width);
+      std::fill(dictionary.begin(), dictionary.end(), 0);
+      width = MIN_CODE_SIZE + 1;
+      last_code = END;
+    }
+    prefix = pixels[i];
+  }
+  writer.write(prefix, width);
+  writer.write(END, width);
+  writer.finish();
+}
+
+} // namespace
+
+GifEncoder::GifEncoder(std::ostream &out, int scale)
+    : out(out), scale(scale), started(false), canvas(), pending(),
+      pending_frames(0), total_frames(0), written_centiseconds(0) {}
+
+void GifEncoder::encode(const Frame &frame) {
+  if (!started) {
+    out.write("GIF89a", 6);
+    put_word(out, WIDTH * scale);
+    put_word(out, HEIGHT * scale);
+    out.put((char)0x80); // global color table of 2 entries
+    out.put(0);          // background color
+    out.put(0);          // square pixels
+    const char palette[] = {0, 0, 0, (char)0xff, (char)0xff, (char)0xff};
+    out.write(palette, sizeof(palette));
+    // NETSCAPE2.0 extension: loop forever
+    const char loop[] = {0x21, (char)0xff, 0x0b, 'N', 'E', 'T', 'S',
+                         'C',  'A',        'P',  'E', '2', '.', '0',
+                         0x03, 0x01,       0x00, 0x00, 0x00};
+    out.write(loop, sizeof(loop));
+    started = true;
+    pending = frame;
+    pending_frames = 1;
+    return;
+  }
+
+  if (frame == pending) {
+    pending_frames++;
+    return;
+  }
+  write_pending();
+  pending = frame;
+  pending_frames = 1;
+}
+
+void GifEncoder::write_pending() {
+  // the first frame is written in full, later ones only where they differ
+  const bool first = total_frames == 0;
+
+  // Frame delays are in centiseconds; carry the rounding so the total
+  // length stays exact at 60 fps
+  total_frames += pending_frames;
+  uint64_t end_centiseconds = (total_frames * 100 + 30) / FRAMES_PER_SECOND;
+  int delay = (int)std::min<uint64_t>(end_centiseconds - written_centiseconds,
+                                      0xffff);
+  written_centiseconds = end_centiseconds;
+
+  // bounding box of the pixels that changed since the last written frame
+  int top = HEIGHT, bottom = -1;
+  uint64_t columns = 0;
+  for (int y = 0; y < HEIGHT; y++) {
+    uint64_t diff = first ? ~0ull : canvas[y] ^ pending[y];
+    if (diff) {
+      top = std::min(top, y);
+      bottom = y;
+      columns |= diff;
+    }
+  }
+  if (bottom < 0) {
+    // nothing changed: a 1x1 frame that only carries the delay
+    top = bottom = 0;
+    columns = 1ull << (WIDTH - 1);
+  }
+  int left = __builtin_clzll(columns);
+  int right = WIDTH - 1 - __builtin_ctzll(columns);
+
+  // graphic control extension: leave the frame in place, set the delay
+  const char control[] = {0x21, (char)0xf9, 0x04, 0x04};
+  out.write(control, sizeof(control));
+  put_word(out, delay);
+  out.put(0); // no transparent color
+  out.put(0);
+
+  const int width = (right - left + 1) * scale;
+  const int height = (bottom - top + 1) * scale;
+  out.put(0x2c); // image descriptor
+  put_word(out, left * scale);
+  put_word(out, top * scale);
+  put_word(out, width);
+  put_word(out, height);
+  out.put(0); // no local color table, not interlaced
+
+  std::vector<uint8_t> pixels;
+  pixels.reserve(width * height);
+  for (int y = top * scale; y < (bottom + 1) * scale; y++) {
+    uint64_t row = pending[y / scale];
+    for (int x = left * scale; x < (right + 1) * scale; x++) {
+      pixels.push_back((row >> (WIDTH - 1 - x / scale)) & 1);
+    }
+  }
+  write_lzw(out, pixels);
+
+  canvas = pending;
+}
+
+void GifEncoder::finish() {
+  if (started) {
+    write_pending();
+    out.put(0x3b); // trailer
+  }
+  out.flush();
+}
+
+// ---- recorder ----
+
+Recorder::Recorder(const std::string &filename, int scale)
+    : dropped(0), running(true) {
+  auto ends_with = [&](const std::string &suffix) {
+    return filename.size() >= suffix.size() &&
+           filename.compare(filename.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+  };
+
+  // checked before opening, so a mistyped name doesn't clobber a file
+  if (!ends_with(".gif") && !ends_with(".y4m") && !ends_with(".raw")) {
+    return;
+  }
+  std::unique_ptr<std::ofstream> stream(
+      new std::ofstream(filename, std::ios::binary));
+  if (!*stream) {
+    return;
+  }
+  if (ends_with(".gif")) {
+    encoder.reset(new GifEncoder(*stream, scale));
+  } else if (ends_with(".y4m")) {
+    encoder.reset(new Y4MEncoder(*stream, scale));
+  } else {
+    encoder.reset(new RawEncoder(*stream));
+  }
+  file = std::move(stream);
+  thread = std::thread(&Recorder::run, this);
+}
+
+Recorder::~Recorder() { close(); }
+
+bool Recorder::submit(const Frame &frame) {
+  if (!ring.push(frame)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void Recorder::submit_wait(const Frame &frame) {
+  while (!ring.push(frame)) {
+    std::this_thread::yield();
+  }
+}
+
+void Recorder::run() {
+  Frame frame;
+  while (true) {
+    // read the flag first so that everything submitted before close() is
+    // drained below
+    bool stopping = !running.load(std::memory_order_acquire);
+    bool idle = true;
+    while (ring.pop(frame)) {
+      encoder->encode(frame);
+      idle = false;
+    }
+    if (stopping) {
+      break;
+    }
+    if (idle) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  encoder->finish();
+}
+
+void Recorder::close() {
+  running.store(false, std::memory_order_release);
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
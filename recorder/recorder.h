@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../chip/chip8.h"
+#include "../ring-buffer/spsc-ring.h"
+
+/**
+ * Turns a stream of frames into a video file. Runs on the recorder thread,
+ * so it may take its time.
+ */
+class FrameEncoder {
+public:
+  virtual ~FrameEncoder() {}
+  virtual void encode(const Frame &frame) = 0;
+  // Flushes anything buffered and writes trailers
+  virtual void finish() = 0;
+};
+
+// Packed frames back to back, 256 bytes each, rows in order, each row big
+// endian so the first byte holds the leftmost 8 pixels
+class RawEncoder : public FrameEncoder {
+private:
+  std::ostream &out;
+
+public:
+  explicit RawEncoder(std::ostream &out) : out(out) {}
+  void encode(const Frame &frame) override;
+  void finish() override;
+};
+
+// Lossless 8-bit grayscale YUV4MPEG2 at 60 fps, which ffmpeg and most
+// players read directly
+class Y4MEncoder : public FrameEncoder {
+private:
+  std::ostream &out;
+  int scale;
+  bool started;
+  Frame previous;
+  std::vector<uint8_t> image; // kept between frames, only changed rows redone
+
+public:
+  Y4MEncoder(std::ostream &out, int scale);
+  void encode(const Frame &frame) override;
+  void finish() override;
+};
+
+/**
+ * Animated two-color GIF. Identical frames are merged into one longer frame
+ * and each new frame only covers the rectangle that changed since the last
+ * one, which for CHIP-8 is usually a sprite or two.
+ */
+class GifEncoder : public FrameEncoder {
+private:
+  std::ostream &out;
+  int scale;
+  bool started;
+  Frame canvas;  // what a viewer shows after the frames written so far
+  Frame pending; // newest frame, not yet written because it may repeat
+  uint64_t pending_frames;
+  uint64_t total_frames;
+  uint64_t written_centiseconds;
+
+  void write_pending();
+
+public:
+  GifEncoder(std::ostream &out, int scale);
+  void encode(const Frame &frame) override;
+  void finish() override;
+};
+
+/**
+ * Records frames on a background thread.
+ * The emulation thread hands frames over through a lock-free ring and never
+ * waits: if the encoder falls behind and the ring is full, the frame is
+ * dropped and counted.
+ */
+class Recorder {
+private:
+  std::unique_ptr<std::ostream> file;
+  std::unique_ptr<FrameEncoder> encoder;
+  SPSCRing<Frame, 256> ring;
+  std::atomic<uint64_t> dropped;
+  std::atomic<bool> running;
+  std::thread thread;
+
+  void run();
+
+public:
+  /**
+   * Opens filename and picks the format from its extension: .gif, .y4m or
+   * .raw. Check ok() afterwards.
+   */
+  Recorder(const std::string &filename, int scale = 4);
+  ~Recorder();
+
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  bool ok() const { return encoder != nullptr; }
+
+  // Emulation thread. Never blocks; returns false if the frame was dropped.
+  bool submit(const Frame &frame);
+  // For offline capture where nothing must be lost: waits for ring space
+  void submit_wait(const Frame &frame);
+
+  uint64_t dropped_frames() const { return dropped.load(); }
+  // Drains everything submitted so far, finishes the file and stops
+  void close();
+};
@@ -0,0 +1,255 @@
+#include "golden.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// The next line that isn't blank or a # comment
+bool next_line(std::istream &in, std::string &line, int &number) {
+  while (std::getline(in, line)) {
+    number++;
+    std::size_t start = line.find_first_not_of(" \t");
+    if (start != std::string::npos && line[start] != '#') {
+      return true;
+    }
+  }
+  return false;
+}
+
+// frame:+key or frame:-key, key in hex
+bool parse_key_event(const std::string &word, ScriptedKey &event) {
+  std::size_t colon = word.find(':');
+  if (colon == std::string::npos || colon + 2 >= word.size() ||
+      (word[colon + 1] != '+' && word[colon + 1] != '-')) {
+    return false;
+  }
+  char *end = nullptr;
+  event.frame = std::strtoull(word.c_str(), &end, 10);
+  if (end != word.c_str() + colon) {
+    return false;
+  }
+  event.pressed = word[colon + 1] == '+';
+  event.key = std::strtol(word.c_str() + colon + 2, &end, 16);
+  return *end == '\0' && event.key >= 0 && event.key < 16;
+}
+
+} // namespace
+
+uint64_t frame_hash(const Frame &frame) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (uint64_t row : frame) {
+    for (int byte = 0; byte < 8; byte++) {
+      hash = (hash ^ ((row >> (8 * byte)) & 0xff)) * 0x100000001b3ull;
+    }
+  }
+  return hash;
+}
+
+bool load_suite(const std::string &path, std::vector<RegressionCase> &cases,
+                std::string &error) {
+  std::ifstream in(path);
+  if (!in) {
+    error = "can't read " + path;
+    return false;
+  }
+  std::string line;
+  int number = 0;
+  while (next_line(in, line, number)) {
+    std::istringstream words(line);
+    RegressionCase test;
+    words >> test.rom;
+    std::string word;
+    while (words >> word) {
+      ScriptedKey event;
+      if (word.find(':') != std::string::npos) {
+        if (!parse_key_event(word, event)) {
+          error = path + ":" + std::to_string(number) + ": bad input " + word;
+          return false;
+        }
+        test.input.push_back(event);
+      } else if (word.find_first_not_of("0123456789") == std::string::npos) {
+        test.checkpoints.push_back(std::stoull(word));
+      } else {
+        error = path + ":" + std::to_string(number) + ": bad field " + word;
+        return false;
+      }
+    }
+    std::sort(test.checkpoints.begin(), test.checkpoints.end());
+    std::stable_sort(test.input.begin(), test.input.end(),
+                     [](const ScriptedKey &a, const ScriptedKey &b) {
+                       return a.frame < b.frame;
+                     });
+    cases.push_back(test);
+  }
+  return true;
+}
+
+bool load_golden(const std::string &path, std::vector<Checkpoint> &golden,
+                 std::string &error) {
+  std::ifstream in(path);
+  if (!in) {
+    error = "can't read " + path;
+    return false;
+  }
+  std::string line;
+  int number = 0;
+  while (next_line(in, line, number)) {
+    std::istringstream header(line);
+    Checkpoint checkpoint;
+    if (!(header >> checkpoint.rom >> checkpoint.frame >> std::hex >>
+          checkpoint.hash)) {
+      error = path + ":" + std::to_string(number) + ": bad checkpoint";
+      return false;
+    }
+    for (uint64_t &row : checkpoint.screen) {
+      std::istringstream hex;
+      if (next_line(in, line, number)) {
+        hex.str(line);
+      }
+      if (!(hex >> std::hex >> row)) {
+        error = path + ":" + std::to_string(number) + ": bad display row";
+        return false;
+      }
+    }
+    golden.push_back(checkpoint);
+  }
+  return true;
+}
+
+bool write_golden(const std::string &path,
+                  const std::vector<Checkpoint> &checkpoints) {
+  std::ofstream out(path);
+  out << "# Written by regression_bin --update: rom, frame and display hash,\n"
+         "# then the display one row per line\n";
+  out << std::hex << std::setfill('0');
+  for (const Checkpoint &checkpoint : checkpoints) {
+    out << checkpoint.rom << " " << std::dec << checkpoint.frame << " "
+        << std::hex << std::setw(16) << checkpoint.hash << "\n";
+    for (uint64_t row : checkpoint.screen) {
+      out << "  " << std::setw(16) << row << "\n";
+    }
+  }
+  return bool(out);
+}
+
+std::vector<Checkpoint> run_case(const RegressionCase &test,
+                                 const std::string &rom_dir) {
+  std::vector<Checkpoint> checkpoints;
+  CHIP8 chip;
+  chip.seed(0);
+  if (!chip.load_rom(rom_dir + "/" + test.rom)) {
+    return checkpoints;
+  }
+  auto event = test.input.begin();
+  for (uint64_t checkpoint : test.checkpoints) {
+    while (chip.frame_number < checkpoint) {
+      for (; event != test.input.end() && event->frame <= chip.frame_number;
+           ++event) {
+        chip.set_key(event->key, event->pressed);
+      }
+      chip.run_frame();
+    }
+    checkpoints.push_back({test.rom, checkpoint,
+                           frame_hash(chip.frame_view()), chip.frame_view()});
+  }
+  return checkpoints;
+}
+
+std::vector<Checkpoint> run_suite(const std::vector<RegressionCase> &cases,
+                                  const std::string &rom_dir, int threads) {
+  std::vector<std::vector<Checkpoint>> results(cases.size());
+  std::atomic<std::size_t> next(0);
+  auto work = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < cases.size();) {
+      results[i] = run_case(cases[i], rom_dir);
+    }
+  };
+
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min<std::size_t>(threads, std::max<std::size_t>(
+                                               cases.size(), 1));
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  std::vector<Checkpoint> checkpoints;
+  for (const std::vector<Checkpoint> &result : results) {
+    checkpoints.insert(checkpoints.end(), result.begin(), result.end());
+  }
+  return checkpoints;
+}
+
+bool write_diff_image(const std::string &path, const Frame &expected,
+                      const Frame &actual, int scale) {
+  std::ofstream out(path, std::ios::binary);
+  out << "P6\n" << WIDTH * scale << " " << HEIGHT * scale << "\n255\n";
+  std::vector<char> row(WIDTH * scale * 3);
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < WIDTH; x++) {
+      bool want = (expected[y] >> (WIDTH - 1 - x)) & 1;
+      bool got = (actual[y] >> (WIDTH - 1 - x)) & 1;
+      const char color[3] = {char(want ? 0xff : 0), char(got ? 0xff : 0),
+                             char(want && got ? 0xff : 0)};
+      for (int i = 0; i < scale; i++) {
+        std::copy(color, color + 3, &row[(x * scale + i) * 3]);
+      }
+    }
+    for (int i = 0; i < scale; i++) {
+      out.write(row.data(), row.size());
+    }
+  }
+  return bool(out);
+}
+
+std::vector<Mismatch> compare(const std::vector<Checkpoint> &golden,
+                              const std::vector<Checkpoint> &actual,
+                              const std::string &diff_dir) {
+  std::map<std::pair<std::string, uint64_t>, const Checkpoint *> found;
+  for (const Checkpoint &checkpoint : actual) {
+    found[{checkpoint.rom, checkpoint.frame}] = &checkpoint;
+  }
+
+  std::vector<Mismatch> mismatches;
+  for (const Checkpoint &expected : golden) {
+    auto it = found.find({expected.rom, expected.frame});
+    if (it == found.end()) {
+      mismatches.push_back({expected.rom, expected.frame, "not run"});
+      continue;
+    }
+    const Checkpoint &got = *it->second;
+    found.erase(it);
+    if (got.hash == expected.hash) {
+      continue;
+    }
+    std::string reason = "display differs";
+    if (!diff_dir.empty()) {
+      std::string image = diff_dir + "/" + expected.rom + "-" +
+                          std::to_string(expected.frame) + ".ppm";
+      if (write_diff_image(image, expected.screen, got.screen)) {
+        reason += ", see " + image;
+      }
+    }
+    mismatches.push_back({expected.rom, expected.frame, reason});
+  }
+  // checkpoints nobody recorded a golden frame for
+  for (const auto &extra : found) {
+    mismatches.push_back(
+        {extra.first.first, extra.first.second, "no golden frame"});
+  }
+  return mismatches;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+/**
+ * Golden-frame regression testing over whole ROMs.
+ *
+ * A suite file lists the ROMs to play, one per line, with the frames to
+ * check the display at and the keys to press on the way:
+ *
+ *   # rom            checkpoints   input
+ *   pong.ch8         60 300 600    100:+1 160:-1
+ *
+ * where 100:+1 presses key 1 before frame 100 runs and 160:-1 releases it.
+ * Every ROM runs from seed 0 at DEFAULT_CYCLES_PER_FRAME, so runs are
+ * reproducible.
+ *
+ * The golden file holds the display at each checkpoint, as its hash and
+ * then 32 rows of 16 hex digits. Comparing hashes is enough to pass; the
+ * rows are there to draw a diff when it doesn't.
+ */
+
+struct ScriptedKey {
+  uint64_t frame;
+  int key;
+  bool pressed;
+};
+
+struct RegressionCase {
+  std::string rom; // relative to the ROM directory
+  std::vector<uint64_t> checkpoints;
+  std::vector<ScriptedKey> input;
+};
+
+struct Checkpoint {
+  std::string rom;
+  uint64_t frame;
+  uint64_t hash;
+  Frame screen;
+};
+
+// FNV-1a over the rows
+uint64_t frame_hash(const Frame &frame);
+
+// false, with the offending line in error, if the file can't be read or
+// parsed
+bool load_suite(const std::string &path, std::vector<RegressionCase> &cases,
+                std::string &error);
+bool load_golden(const std::string &path, std::vector<Checkpoint> &golden,
+                 std::string &error);
+bool write_golden(const std::string &path,
+                  const std::vector<Checkpoint> &checkpoints);
+
+// Plays one ROM; empty if it can't be loaded
+std::vector<Checkpoint> run_case(const RegressionCase &test,
+                                 const std::string &rom_dir);
+
+/**
+ * Plays every case, spread over threads (0 for one per core), and returns
+ * their checkpoints in suite order.
+ */
+std::vector<Checkpoint> run_suite(const std::vector<RegressionCase> &cases,
+                                  const std::string &rom_dir, int threads = 0);
+
+/**
+ * Binary PPM at scale: pixels lit in both white, only in expected red,
+ * only in actual green.
+ */
+bool write_diff_image(const std::string &path, const Frame &expected,
+                      const Frame &actual, int scale = 8);
+
+struct Mismatch {
+  std::string rom;
+  uint64_t frame;
+  std::string reason;
+};
+
+/**
+ * Compares actual against golden, checkpoint by checkpoint. With diff_dir
+ * set, writes <rom>-<frame>.ppm there for every display that differs.
+ */
+std::vector<Mismatch> compare(const std::vector<Checkpoint> &golden,
+                              const std::vector<Checkpoint> &actual,
+                              const std::string &diff_dir = "");
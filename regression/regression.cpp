@@ -0,0 +1,84 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "golden.h"
+
+// Plays every ROM in a suite and checks its displays against the golden
+// file, e.g. from the build directory:
+//   ./regression_bin ../test/golden/suite.txt ../test/golden/golden.txt
+//       ../demo-roms --diff-dir diffs
+// After a change that is meant to alter what ROMs show, --update rewrites
+// the golden file from this run instead; review its diff before committing.
+int main(int argc, char *argv[]) {
+  bool update = false;
+  int threads = 0;
+  std::string diff_dir;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--update") {
+      update = true;
+    } else if (arg == "--threads" && has_value) {
+      threads = std::atoi(argv[++i]);
+    } else if (arg == "--diff-dir" && has_value) {
+      diff_dir = argv[++i];
+    } else if (arg.compare(0, 2, "--") == 0) {
+      paths.clear();
+      break;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() != 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--update] [--threads <n>] [--diff-dir <dir>]"
+                 " <suite> <golden file> <ROM dir>"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  const std::string &suite = paths[0], &golden_path = paths[1],
+                    &rom_dir = paths[2];
+
+  std::vector<RegressionCase> cases;
+  std::string error;
+  if (!load_suite(suite, cases, error)) {
+    std::cerr << error << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Checkpoint> actual = run_suite(cases, rom_dir, threads);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  if (update) {
+    if (!write_golden(golden_path, actual)) {
+      std::cerr << "Can't write " << golden_path << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    std::cout << "Wrote " << actual.size() << " checkpoints to "
+              << golden_path << std::endl;
+    return 0;
+  }
+
+  std::vector<Checkpoint> golden;
+  if (!load_golden(golden_path, golden, error)) {
+    std::cerr << error << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::vector<Mismatch> mismatches = compare(golden, actual, diff_dir);
+  for (const Mismatch &mismatch : mismatches) {
+    std::cout << mismatch.rom << " frame " << mismatch.frame << ": "
+              << mismatch.reason << std::endl;
+  }
+  std::cout << cases.size() << " ROMs, " << golden.size() << " checkpoints, "
+            << mismatches.size() << " failed in " << seconds << " s"
+            << std::endl;
+  return mismatches.empty() ? 0 : 1;
+}
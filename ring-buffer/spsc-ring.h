@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Most x86/ARM cores use 64 byte cache lines
+const std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Bounded single-producer/single-consumer ring buffer.
+ * Exactly one thread may call push() and exactly one thread may call pop();
+ * neither side ever blocks or takes a lock. Capacity must be a power of two.
+ */
+template <typename T, std::size_t Capacity> class SPSCRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SPSCRing capacity must be a power of two");
+
+private:
+  static const std::size_t MASK = Capacity - 1;
+
+  // head is only written by the consumer, tail only by the producer. Padding
+  // them onto separate cache lines stops the two threads from false sharing.
+  // (Padding rather than alignas, which plain new can't honor before C++17.)
+  std::atomic<std::size_t> head;
+  char head_padding[CACHE_LINE_SIZE];
+  std::atomic<std::size_t> tail;
+  char tail_padding[CACHE_LINE_SIZE];
+  std::array<T, Capacity> slots;
+
+public:
+  SPSCRing() : head(0), tail(0), slots() {}
+
+  SPSCRing(const SPSCRing &) = delete;
+  SPSCRing &operator=(const SPSCRing &) = delete;
+
+  // Producer side. Returns false (and drops the value) when the ring is full.
+  bool push(const T &value) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    slots[t & MASK] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the ring is empty.
+  bool pop(T &value) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = slots[h & MASK];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Looks at the oldest element without removing it.
+  const T *peek() const {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots[h & MASK];
+  }
+
+  // Approximate when called from a third thread, exact from either side.
+  std::size_t size() const {
+    return tail.load(std::memory_order_acquire) -
+           head.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Where CXKK gets its bytes when something other than the built-in
+ * generator should decide them, e.g. a ReplaySource feeding back the bytes
+ * a RecordingSource captured on an earlier run.
+ */
+class RandomSource {
+public:
+  virtual ~RandomSource() {}
+  virtual uint8_t next_byte() = 0;
+};
+
+/**
+ * xorshift64*: three shifts and a multiply per byte, no distribution object.
+ * The top byte of the product is the best mixed, so that's the one we return.
+ */
+class FastRandom {
+private:
+  uint64_t state;
+
+public:
+  explicit FastRandom(uint64_t seed = 0) { this->seed(seed); }
+
+  // Runs the seed through splitmix64 so that 0, 1, 2... give unrelated
+  // streams, and never leaves the all-zero state xorshift can't escape
+  void seed(uint64_t seed) {
+    uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    state = z ? z : 1;
+  }
+
+  inline uint8_t next_byte() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (state * 0x2545f4914f6cdd1dull) >> 56;
+  }
+};
+
+// Hands out a FastRandom stream and keeps a copy of every byte
+class RecordingSource : public RandomSource {
+private:
+  FastRandom random;
+
+public:
+  std::vector<uint8_t> bytes;
+
+  explicit RecordingSource(uint64_t seed) : random(seed) {}
+
+  uint8_t next_byte() override {
+    uint8_t byte = random.next_byte();
+    bytes.push_back(byte);
+    return byte;
+  }
+};
+
+// Plays back a recorded stream, then zeros once it runs out
+class ReplaySource : public RandomSource {
+private:
+  std::vector<uint8_t> bytes;
+  std::size_t position = 0;
+
+public:
+  explicit ReplaySource(std::vector<uint8_t> bytes)
+      : bytes(std::move(bytes)) {}
+
+  uint8_t next_byte() override {
+    return position < bytes.size() ? bytes[position++] : 0;
+  }
+
+  bool exhausted() const { return position >= bytes.size(); }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_audio.h>
+#include <algorithm>
+#include <iostream>
+
+#include "../audio/audio.h"
+#include "../ring-buffer/spsc-ring.h"
+
+// 256 samples is ~5.8 ms per device callback at 44.1 kHz
+const int AUDIO_DEVICE_SAMPLES = 256;
+// Queue depth the emulation thread steers towards. Together with the device
+// buffer this keeps end-to-end latency around 12 ms.
+const std::size_t AUDIO_TARGET_QUEUED = 256;
+
+/**
+ * Plays samples through SDL. The emulation thread writes into a lock-free
+ * ring, the SDL audio callback drains it; if the ring runs dry the callback
+ * plays silence rather than waiting.
+ */
+class SDLAudio : public AudioSink {
+private:
+  SDL_AudioDeviceID device;
+  SPSCRing<int16_t, 4096> ring;
+
+  static void callback(void *userdata, Uint8 *stream, int len) {
+    SDLAudio *self = static_cast<SDLAudio *>(userdata);
+    int16_t *out = reinterpret_cast<int16_t *>(stream);
+    int count = len / (int)sizeof(int16_t);
+    for (int i = 0; i < count; i++) {
+      if (!self->ring.pop(out[i])) {
+        out[i] = 0;
+      }
+    }
+  }
+
+public:
+  SDLAudio() : device(0) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+      std::cerr << "SDL audio could not initialize: " << SDL_GetError()
+                << std::endl;
+      return;
+    }
+
+    SDL_AudioSpec want = {};
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = AUDIO_DEVICE_SAMPLES;
+    want.callback = &SDLAudio::callback;
+    want.userdata = this;
+
+    // Passing no allowed changes makes SDL convert for us if the device
+    // doesn't support the format natively
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, nullptr, 0);
+    if (device == 0) {
+      std::cerr << "SDL audio could not initialize: " << SDL_GetError()
+                << std::endl;
+      return;
+    }
+    SDL_PauseAudioDevice(device, 0);
+  }
+
+  ~SDLAudio() {
+    if (device != 0) {
+      SDL_CloseAudioDevice(device);
+    }
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+  }
+
+  SDLAudio(const SDLAudio &) = delete;
+  SDLAudio &operator=(const SDLAudio &) = delete;
+
+  void write(const int16_t *samples, std::size_t count) override {
+    // a full ring means the device stopped pulling; drop instead of blocking
+    for (std::size_t i = 0; i < count && ring.push(samples[i]); i++) {
+    }
+  }
+
+  std::size_t frame_samples(std::size_t nominal) override {
+    // The emulation clock and the sound card clock drift apart; stretch or
+    // shrink each frame slightly to keep the queue at its target depth
+    long error = (long)AUDIO_TARGET_QUEUED - (long)ring.size();
+    long adjust = std::max(-32L, std::min(32L, error / 8));
+    return nominal + adjust;
+  }
+};
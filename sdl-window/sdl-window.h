@@ -1,19 +1,50 @@
+#pragma once
+
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_render.h>
+#include <array>
 #include <iostream>
 #include <memory>
 #include <string>
-#include <unordered_map>
+
+#include "../filter/phosphor.h"
+#include "../input-queue/input-queue.h"
 
 const int PIXEL_WIDTH = 64;
 const int PIXEL_HEIGHT = 32;
-const int VIDEO_PITCH = sizeof(uint32_t) * PIXEL_WIDTH;
-const std::unordered_map<SDL_Keycode, int> keymap = {
-    {SDLK_1, 1},   {SDLK_2, 2},   {SDLK_3, 3},   {SDLK_4, 0xc},
-    {SDLK_q, 4},   {SDLK_w, 5},   {SDLK_e, 0x6}, {SDLK_r, 0xd},
-    {SDLK_a, 0x7}, {SDLK_s, 0x8}, {SDLK_d, 0x9}, {SDLK_f, 0xe},
-    {SDLK_z, 0xa}, {SDLK_x, 0x0}, {SDLK_c, 0xb}, {SDLK_v, 0xf}};
+
+// The mapped keys are all printable ASCII, which is what SDL uses as their
+// keycodes, so a flat table replaces a hash lookup. -1 means unmapped.
+const std::array<int8_t, 128> keymap = [] {
+  std::array<int8_t, 128> map;
+  map.fill(-1);
+  map[SDLK_1] = 0x1;
+  map[SDLK_2] = 0x2;
+  map[SDLK_3] = 0x3;
+  map[SDLK_4] = 0xc;
+  map[SDLK_q] = 0x4;
+  map[SDLK_w] = 0x5;
+  map[SDLK_e] = 0x6;
+  map[SDLK_r] = 0xd;
+  map[SDLK_a] = 0x7;
+  map[SDLK_s] = 0x8;
+  map[SDLK_d] = 0x9;
+  map[SDLK_f] = 0xe;
+  map[SDLK_z] = 0xa;
+  map[SDLK_x] = 0x0;
+  map[SDLK_c] = 0xb;
+  map[SDLK_v] = 0xf;
+  return map;
+}();
+
+// Frontend shortcuts pressed since the last process_input call
+struct Hotkeys {
+  bool turbo = false;        // Tab
+  bool slow_motion = false;  // Backspace
+  bool next_rom = false;     // Page Down
+  bool previous_rom = false; // Page Up
+};
 
 class SDLWindow {
 private:
@@ -22,14 +53,14 @@ private:
   SDL_Renderer *renderer;
   SDL_Texture *texture;
   int scale;
+  std::unique_ptr<PhosphorFilter> filter;
 
-  template <std::size_t Size>
-  void handle_key(const SDL_Keycode key, std::array<uint8_t, Size> &keys,
+  void handle_key(const SDL_Keycode key, InputQueue &input,
                   const bool isKeyDown) {
-    auto it = keymap.find(key);
-    if (it != keymap.end()) {
-      keys[it->second] = isKeyDown ? 1 : 0;
+    if (key < 0 || key >= (SDL_Keycode)keymap.size() || keymap[key] < 0) {
+      return;
     }
+    input.push(keymap[key], isKeyDown);
   }
 
 public:
@@ -48,7 +79,8 @@ public:
       return;
     }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(
+        window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (renderer == nullptr) {
       std::cerr << "SDL could not initialize: %s\n" << SDL_GetError();
       return;
@@ -63,6 +95,9 @@ public:
     }
   }
 
+  SDLWindow(const SDLWindow &) = delete;
+  SDLWindow &operator=(const SDLWindow &) = delete;
+
   ~SDLWindow() {
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
@@ -70,16 +105,59 @@ public:
     SDL_Quit();
   }
 
-  template <std::size_t Width, std::size_t Height>
-  void update(const std::array<std::array<uint32_t, Width>, Height> &buffer) {
-    SDL_UpdateTexture(texture, nullptr, buffer.data(), VIDEO_PITCH);
+  /**
+   * Renders through a PhosphorFilter from now on. The texture is recreated
+   * at the filter's output size so SDL only has to copy it to the screen.
+   */
+  void enable_filter(double decay, bool scale2x, bool scanlines) {
+    filter.reset(new PhosphorFilter(scale, decay, scale2x, scanlines));
+    SDL_Texture *filtered = SDL_CreateTexture(
+        renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+        filter->output_width(), filter->output_height());
+    if (filtered == nullptr) {
+      std::cerr << "Can't create the filter texture: " << SDL_GetError()
+                << std::endl;
+      filter.reset();
+      return;
+    }
+    SDL_DestroyTexture(texture);
+    texture = filtered;
+  }
+
+  void set_title(const std::string &title) {
+    SDL_SetWindowTitle(window, title.c_str());
+  }
+
+  /**
+   * Expands a 1-bit packed frame straight into the streaming texture, through
+   * the filter if there is one, and presents it. The renderer is vsync'd, so
+   * this blocks until the next refresh.
+   */
+  template <std::size_t Height>
+  void update(const std::array<uint64_t, Height> &buffer) {
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, nullptr, &pixels, &pitch) == 0) {
+      if (filter) {
+        filter->apply(buffer, (uint32_t *)pixels, pitch);
+      } else {
+        for (std::size_t y = 0; y < Height; y++) {
+          uint32_t *row = (uint32_t *)((uint8_t *)pixels + y * pitch);
+          uint64_t bits = buffer[y];
+          for (int x = 0; x < PIXEL_WIDTH; x++) {
+            row[x] = (bits >> (PIXEL_WIDTH - 1 - x)) & 1 ? 0xffffffff : 0;
+          }
+        }
+      }
+      SDL_UnlockTexture(texture);
+    }
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, nullptr, nullptr);
     SDL_RenderPresent(renderer);
   }
 
-  template <std::size_t Size>
-  bool process_input(std::array<uint8_t, Size> &keys) {
+  // Polls pending events and forwards keypad changes to the input queue
+  bool process_input(InputQueue &input, Hotkeys &hotkeys) {
     bool quit = false;
 
     SDL_Event e;
@@ -93,10 +171,29 @@ public:
           quit = true;
           break;
         }
-        handle_key(e.key.keysym.sym, keys, true);
+        if (e.key.repeat) {
+          break;
+        }
+        if (e.key.keysym.sym == SDLK_TAB) {
+          hotkeys.turbo = true;
+          break;
+        }
+        if (e.key.keysym.sym == SDLK_BACKSPACE) {
+          hotkeys.slow_motion = true;
+          break;
+        }
+        if (e.key.keysym.sym == SDLK_PAGEDOWN) {
+          hotkeys.next_rom = true;
+          break;
+        }
+        if (e.key.keysym.sym == SDLK_PAGEUP) {
+          hotkeys.previous_rom = true;
+          break;
+        }
+        handle_key(e.key.keysym.sym, input, true);
         break;
       case SDL_KEYUP:
-        handle_key(e.key.keysym.sym, keys, false);
+        handle_key(e.key.keysym.sym, input, false);
         break;
       }
     }
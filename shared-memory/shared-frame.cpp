@@ -0,0 +1,157 @@
+#include "shared-frame.h"
+
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SharedRegion::SharedRegion(const std::string &name, bool create)
+    : name(name), owner(create), layout(nullptr) {
+  int flags = create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR;
+  int fd = shm_open(name.c_str(), flags, 0600);
+  if (fd < 0) {
+    return;
+  }
+  if (create && ftruncate(fd, sizeof(SharedFrameLayout)) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      info.st_size < (off_t)sizeof(SharedFrameLayout)) {
+    close(fd);
+    return;
+  }
+  void *address = mmap(nullptr, sizeof(SharedFrameLayout),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  // the mapping stays valid without the descriptor
+  close(fd);
+  if (address == MAP_FAILED) {
+    if (create) {
+      shm_unlink(name.c_str());
+    }
+    return;
+  }
+
+  if (create) {
+    layout = new (address) SharedFrameLayout();
+    layout->version = SharedFrameLayout::VERSION;
+    layout->magic.store(SharedFrameLayout::MAGIC, std::memory_order_release);
+  } else {
+    layout = static_cast<SharedFrameLayout *>(address);
+  }
+}
+
+SharedRegion::~SharedRegion() {
+  if (layout) {
+    munmap(layout, sizeof(SharedFrameLayout));
+  }
+  if (owner && layout) {
+    shm_unlink(name.c_str());
+  }
+}
+
+SharedFramePublisher::SharedFramePublisher(const std::string &name)
+    : region(name, true) {}
+
+namespace {
+inline uint64_t pack_registers(const CHIP8 &chip, int first) {
+  uint64_t word = 0;
+  for (int i = 7; i >= 0; i--) {
+    word = (word << 8) | chip.registers[first + i];
+  }
+  return word;
+}
+} // namespace
+
+void SharedFramePublisher::publish(const CHIP8 &chip) {
+  SharedFrameLayout &shared = region.get();
+  const auto relaxed = std::memory_order_relaxed;
+
+  uint32_t sequence = shared.sequence.load(relaxed);
+  shared.sequence.store(sequence + 1, relaxed);
+  // the odd sequence must be visible before any of the stores below
+  std::atomic_thread_fence(std::memory_order_release);
+
+  shared.frame_number.store(chip.frame_number, relaxed);
+  for (int y = 0; y < HEIGHT; y++) {
+    shared.screen[y].store(chip.screen[y], relaxed);
+  }
+  shared.registers[0].store(pack_registers(chip, 0), relaxed);
+  shared.registers[1].store(pack_registers(chip, 8), relaxed);
+  shared.machine.store(uint64_t(chip.address_i) |
+                           uint64_t(chip.program_counter) << 16 |
+                           uint64_t(chip.delay_timer) << 32 |
+                           uint64_t(chip.sound_timer) << 40,
+                       relaxed);
+
+  shared.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void SharedFramePublisher::apply_keys(CHIP8 &chip) {
+  uint32_t keys = region.get().keys.load(std::memory_order_relaxed);
+  for (int key = 0; key < 16; key++) {
+    chip.keypad[key] = (keys >> key) & 1;
+  }
+}
+
+SharedFrameReader::SharedFrameReader(const std::string &name)
+    : region(name, false), last_sequence(0) {}
+
+bool SharedFrameReader::ok() {
+  return region.ok() &&
+         region.get().magic.load(std::memory_order_acquire) ==
+             SharedFrameLayout::MAGIC &&
+         region.get().version == SharedFrameLayout::VERSION;
+}
+
+bool SharedFrameReader::read(SharedSnapshot &out) {
+  SharedFrameLayout &shared = region.get();
+  const auto relaxed = std::memory_order_relaxed;
+
+  SharedSnapshot copy;
+  for (;;) {
+    uint32_t before = shared.sequence.load(std::memory_order_acquire);
+    if (before == last_sequence) {
+      return false;
+    }
+    if (before & 1) {
+      continue;
+    }
+
+    copy.frame_number = shared.frame_number.load(relaxed);
+    for (int y = 0; y < HEIGHT; y++) {
+      copy.screen[y] = shared.screen[y].load(relaxed);
+    }
+    for (int word = 0; word < 2; word++) {
+      uint64_t bytes = shared.registers[word].load(relaxed);
+      for (int i = 0; i < 8; i++) {
+        copy.registers[word * 8 + i] = bytes >> (i * 8);
+      }
+    }
+    uint64_t machine = shared.machine.load(relaxed);
+    copy.address_i = machine;
+    copy.program_counter = machine >> 16;
+    copy.delay_timer = machine >> 32;
+    copy.sound_timer = machine >> 40;
+
+    // the loads above must complete before sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shared.sequence.load(relaxed) == before) {
+      last_sequence = before;
+      out = copy;
+      return true;
+    }
+  }
+}
+
+void SharedFrameReader::set_key(int key, bool pressed) {
+  uint32_t bit = 1u << (key & 0xf);
+  if (pressed) {
+    region.get().keys.fetch_or(bit, std::memory_order_relaxed);
+  } else {
+    region.get().keys.fetch_and(~bit, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "../chip/chip8.h"
+
+/**
+ * The layout of the shared-memory region, the same in every process that
+ * maps it. The emulator owns everything but keys, which the consumer writes.
+ *
+ * Machine state is guarded by a seqlock: the writer makes sequence odd,
+ * stores, then makes it even again. A reader copies between two loads of
+ * sequence and keeps the copy only if both were the same even value. Every
+ * word is a relaxed atomic so that a torn read is merely discarded rather
+ * than undefined behaviour; on x86 and ARM those are plain loads and stores.
+ */
+struct SharedFrameLayout {
+  static const uint32_t MAGIC = 0x43384652; // "C8FR"
+  static const uint32_t VERSION = 1;
+
+  // Set last by the creator, so a reader never sees a half made region
+  std::atomic<uint32_t> magic;
+  uint32_t version;
+
+  std::atomic<uint32_t> sequence;
+  std::atomic<uint64_t> frame_number;
+  std::array<std::atomic<uint64_t>, HEIGHT> screen;
+  // V0-V7 and V8-VF, little endian
+  std::array<std::atomic<uint64_t>, 2> registers;
+  // I, PC, delay timer and sound timer in bits 0-15, 16-31, 32-39, 40-47
+  std::atomic<uint64_t> machine;
+
+  // Consumer to emulator: bit n is key n
+  std::atomic<uint32_t> keys;
+};
+
+// Lock-based atomics would keep their locks in this process only
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "shared-memory atomics must be lock free");
+
+// What a consumer gets out of one consistent read
+struct SharedSnapshot {
+  uint64_t frame_number;
+  Frame screen;
+  std::array<BYTE, 16> registers;
+  WORD address_i;
+  WORD program_counter;
+  BYTE delay_timer;
+  BYTE sound_timer;
+};
+
+// A POSIX shared-memory object mapped for reading and writing
+class SharedRegion {
+private:
+  std::string name;
+  bool owner;
+  SharedFrameLayout *layout;
+
+public:
+  /**
+   * Creates (owner) or opens a region called name, which should start with
+   * '/'. The owner unlinks it on destruction. Check ok() afterwards.
+   */
+  SharedRegion(const std::string &name, bool create);
+  ~SharedRegion();
+
+  SharedRegion(const SharedRegion &) = delete;
+  SharedRegion &operator=(const SharedRegion &) = delete;
+
+  bool ok() const { return layout != nullptr; }
+  SharedFrameLayout &get() { return *layout; }
+};
+
+/**
+ * The emulator's side. publish() after each frame costs a few dozen stores
+ * and no syscalls; apply_keys() copies the consumer's keys to the keypad.
+ */
+class SharedFramePublisher {
+private:
+  SharedRegion region;
+
+public:
+  explicit SharedFramePublisher(const std::string &name);
+
+  bool ok() const { return region.ok(); }
+  void publish(const CHIP8 &chip);
+  void apply_keys(CHIP8 &chip);
+};
+
+// The consumer's side, e.g. a dashboard or test bot in another process
+class SharedFrameReader {
+private:
+  SharedRegion region;
+  uint32_t last_sequence;
+
+public:
+  explicit SharedFrameReader(const std::string &name);
+
+  // false if the region doesn't exist or was made by an incompatible build
+  bool ok();
+  /**
+   * Copies the latest published state. Returns false without touching out
+   * if nothing was published since the last successful read. Retries while
+   * the emulator is mid-publish, which never lasts long.
+   */
+  bool read(SharedSnapshot &out);
+  void set_key(int key, bool pressed);
+};
@@ -0,0 +1,528 @@
+#include "stream-server.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+const uint32_t ALL_ROWS = 0xffffffffu;
+
+static_assert(HEIGHT == 32, "FRAME row masks are 32 bits");
+
+bool send_all(int fd, iovec *iov, int count) {
+  while (count > 0) {
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = std::min(count, IOV_MAX);
+    ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // skip what went out, which may end partway through an entry
+    while (count > 0 && size_t(sent) >= iov->iov_len) {
+      sent -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + sent;
+      iov->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+// Sends what the socket takes without blocking, leaving iov at what's
+// left; false on an error. Like send_all, iov may end partway
+bool send_nonblocking(int fd, iovec *&iov, int &count) {
+  while (count > 0) {
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = std::min(count, IOV_MAX);
+    ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    while (count > 0 && size_t(sent) >= iov->iov_len) {
+      sent -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + sent;
+      iov->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+// Listens on and connects to 127.0.0.1 only: this is not meant to be
+// exposed to a network
+sockaddr_in loopback(uint16_t port) {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return address;
+}
+
+bool unix_address(const std::string &path, sockaddr_un &address) {
+  address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::strcpy(address.sun_path, path.c_str());
+  return true;
+}
+} // namespace
+
+StreamServer::StreamServer(const std::vector<uint8_t> &rom, int instance_count,
+                           int cycles_per_frame, uint64_t seed)
+    : port(0), running(false) {
+  // loaded once and copied, so with paged memory every instance shares
+  // the ROM's pages
+  CHIP8 loaded;
+  loaded.cycles_per_frame = cycles_per_frame;
+  loaded.load_rom(rom.data(), rom.size());
+  instances.assign(instance_count, loaded);
+  for (int i = 0; i < instance_count; i++) {
+    // distinct but reproducible streams per instance
+    instances[i].seed(seed + i);
+  }
+}
+
+StreamServer::~StreamServer() {
+  for (auto &connection : connections) {
+    close(connection->fd);
+  }
+  for (int listener : listeners) {
+    close(listener);
+  }
+  if (!unix_path.empty()) {
+    unlink(unix_path.c_str());
+  }
+}
+
+bool StreamServer::listen_unix(const std::string &path) {
+  sockaddr_un address;
+  if (!unix_address(path, address)) {
+    return false;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  unlink(path.c_str()); // a socket file left behind by an earlier run
+  if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return false;
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  listeners.push_back(fd);
+  unix_path = path;
+  return true;
+}
+
+bool StreamServer::listen_tcp(uint16_t requested_port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  sockaddr_in address = loopback(requested_port);
+  socklen_t length = sizeof(address);
+  if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0 ||
+      getsockname(fd, (sockaddr *)&address, &length) != 0) {
+    close(fd);
+    return false;
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  listeners.push_back(fd);
+  port = ntohs(address.sin_port);
+  return true;
+}
+
+void StreamServer::accept_from(int listener) {
+  for (;;) {
+    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd < 0) {
+      return;
+    }
+    // frames are small and latency matters more than packet count
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    connections.emplace_back(new Connection());
+    connections.back()->fd = fd;
+  }
+}
+
+bool StreamServer::read_from(Connection &connection) {
+  // take everything that's there now, so a large RESTORE isn't left
+  // half read until the next frame
+  std::vector<uint8_t> &inbox = connection.inbox;
+  uint8_t buffer[4096];
+  for (;;) {
+    ssize_t received =
+        recv(connection.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (received > 0) {
+      inbox.insert(inbox.end(), buffer, buffer + received);
+    } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else if (received == 0 || errno != EINTR) {
+      return false; // hung up
+    }
+  }
+
+  std::size_t offset = 0;
+  while (inbox.size() - offset >= sizeof(MessageHeader)) {
+    MessageHeader header;
+    std::memcpy(&header, inbox.data() + offset, sizeof(header));
+    if (header.length > MAX_MESSAGE_LENGTH) {
+      return false;
+    }
+    if (inbox.size() - offset < sizeof(header) + header.length) {
+      break;
+    }
+    if (!handle(connection, header,
+                inbox.data() + offset + sizeof(header))) {
+      return false;
+    }
+    offset += sizeof(header) + header.length;
+  }
+  inbox.erase(inbox.begin(), inbox.begin() + offset);
+  return true;
+}
+
+bool StreamServer::handle(Connection &connection, const MessageHeader &header,
+                          const uint8_t *payload) {
+  if (header.instance >= instances.size()) {
+    return false;
+  }
+  CHIP8 &chip = instances[header.instance];
+
+  switch (header.type) {
+  case MSG_SUBSCRIBE:
+    connection.subscriptions[header.instance] = Subscription();
+    return true;
+  case MSG_KEY:
+    if (header.length != 2) {
+      return false;
+    }
+    chip.set_key(payload[0], payload[1] != 0);
+    return true;
+  case MSG_ACK: {
+    auto found = connection.subscriptions.find(header.instance);
+    if (header.length != sizeof(uint64_t) ||
+        found == connection.subscriptions.end()) {
+      return false;
+    }
+    uint64_t frame_number;
+    std::memcpy(&frame_number, payload, sizeof(frame_number));
+    Subscription &subscription = found->second;
+    auto &unacked = subscription.unacked;
+    // newest first: a RESTORE can bring back frame numbers already sent
+    auto acked = std::find_if(unacked.rbegin(), unacked.rend(),
+                              [&](const SentFrame &sent) {
+                                return sent.frame_number == frame_number;
+                              });
+    if (acked == unacked.rend()) {
+      // too old to know what the client has: start again from full frames
+      subscription.has_acked = false;
+      unacked.clear();
+    } else {
+      subscription.acked = acked->screen;
+      subscription.has_acked = true;
+      unacked.erase(unacked.begin(), acked.base());
+    }
+    return true;
+  }
+  case MSG_SNAPSHOT: {
+    std::vector<uint8_t> state;
+    chip.save_state(state);
+    MessageHeader reply{MSG_STATE, 0, header.instance, uint32_t(state.size())};
+    iovec iov[2] = {{&reply, sizeof(reply)}, {state.data(), state.size()}};
+    return send_or_queue(connection, iov, 2);
+  }
+  case MSG_RESTORE:
+    // the client's displays still hold, so deltas carry on from them
+    return chip.restore_state(payload, header.length);
+  default:
+    return false;
+  }
+}
+
+void StreamServer::service(int timeout_ms) {
+  std::vector<pollfd> fds;
+  for (int listener : listeners) {
+    fds.push_back({listener, POLLIN, 0});
+  }
+  for (auto &connection : connections) {
+    short events = POLLIN;
+    if (!connection->outbox.empty()) {
+      events |= POLLOUT;
+    }
+    fds.push_back({connection->fd, events, 0});
+  }
+  if (poll(fds.data(), fds.size(), timeout_ms) <= 0) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < listeners.size(); i++) {
+    if (fds[i].revents & POLLIN) {
+      accept_from(listeners[i]);
+    }
+  }
+  // accept_from() only appended, so the polled connections are the first
+  std::size_t polled = fds.size() - listeners.size();
+  std::vector<bool> keep(connections.size(), true);
+  for (std::size_t i = 0; i < polled; i++) {
+    short events = fds[listeners.size() + i].revents;
+    if (events & POLLOUT) {
+      keep[i] = flush(*connections[i]);
+    }
+    if (keep[i] && events & (POLLIN | POLLHUP | POLLERR)) {
+      keep[i] = read_from(*connections[i]);
+    }
+  }
+  for (std::size_t i = connections.size(); i-- > 0;) {
+    if (!keep[i]) {
+      close(connections[i]->fd);
+      connections.erase(connections.begin() + i);
+    }
+  }
+}
+
+bool StreamServer::send_or_queue(Connection &connection, iovec *iov,
+                                 int count) {
+  // nothing may overtake what's already waiting
+  if (connection.outbox.empty() &&
+      !send_nonblocking(connection.fd, iov, count)) {
+    return false;
+  }
+  std::vector<uint8_t> &outbox = connection.outbox;
+  for (int i = 0; i < count; i++) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(iov[i].iov_base);
+    outbox.insert(outbox.end(), bytes, bytes + iov[i].iov_len);
+  }
+  return outbox.size() <= MAX_OUTBOX;
+}
+
+bool StreamServer::flush(Connection &connection) {
+  std::vector<uint8_t> &outbox = connection.outbox;
+  iovec whole = {outbox.data(), outbox.size()};
+  iovec *iov = &whole;
+  int count = 1;
+  if (!send_nonblocking(connection.fd, iov, count)) {
+    return false;
+  }
+  outbox.erase(outbox.begin(), outbox.end() - (count ? whole.iov_len : 0));
+  return true;
+}
+
+bool StreamServer::send_frames(Connection &connection) {
+  if (!connection.outbox.empty()) {
+    // still behind: skip this frame, the next delta covers it
+    return true;
+  }
+
+  struct FrameHeader {
+    MessageHeader header;
+    uint64_t frame_number;
+    uint32_t row_mask;
+  } __attribute__((packed));
+
+  std::vector<FrameHeader> headers;
+  headers.reserve(connection.subscriptions.size());
+  std::vector<iovec> iov;
+
+  for (auto &entry : connection.subscriptions) {
+    const CHIP8 &chip = instances[entry.first];
+    Subscription &subscription = entry.second;
+
+    uint32_t row_mask = ALL_ROWS;
+    if (subscription.has_acked) {
+      row_mask = 0;
+      for (int y = 0; y < HEIGHT; y++) {
+        row_mask |= uint32_t(chip.screen[y] != subscription.acked[y]) << y;
+      }
+    }
+    int rows = __builtin_popcount(row_mask);
+    uint32_t length = sizeof(uint64_t) + sizeof(uint32_t) + rows * 8;
+    headers.push_back({{MSG_FRAME, 0, entry.first, length},
+                       chip.frame_number,
+                       row_mask});
+    iov.push_back({&headers.back(), sizeof(FrameHeader)});
+    // rows go out straight from the instance's screen
+    for (int y = 0; y < HEIGHT; y++) {
+      if (row_mask >> y & 1) {
+        iov.push_back({const_cast<uint64_t *>(&chip.screen[y]), 8});
+      }
+    }
+
+    if (subscription.unacked.size() == MAX_UNACKED) {
+      subscription.unacked.pop_front();
+    }
+    subscription.unacked.push_back({chip.frame_number, chip.screen});
+  }
+  return iov.empty() || send_or_queue(connection, iov.data(), iov.size());
+}
+
+void StreamServer::step() {
+  for (CHIP8 &chip : instances) {
+    chip.run_frame();
+  }
+  for (std::size_t i = connections.size(); i-- > 0;) {
+    if (!send_frames(*connections[i])) {
+      close(connections[i]->fd);
+      connections.erase(connections.begin() + i);
+    }
+  }
+}
+
+void StreamServer::run() {
+  typedef std::chrono::steady_clock Clock;
+  const auto frame_time =
+      std::chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+  running = true;
+  auto next_frame = Clock::now();
+  while (running) {
+    next_frame += frame_time;
+    // handle input right up to the frame boundary
+    for (auto now = Clock::now(); now < next_frame; now = Clock::now()) {
+      auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+          next_frame - now);
+      service(std::max<int>(0, wait.count()));
+    }
+    step();
+  }
+}
+
+StreamClient::~StreamClient() {
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+bool StreamClient::connect_unix(const std::string &path) {
+  sockaddr_un address;
+  if (!unix_address(path, address)) {
+    return false;
+  }
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  return fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) == 0;
+}
+
+bool StreamClient::connect_tcp(uint16_t port) {
+  sockaddr_in address = loopback(port);
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0) {
+    return false;
+  }
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  return true;
+}
+
+bool StreamClient::send_message(uint8_t type, uint16_t instance,
+                                const void *payload, uint32_t length) {
+  MessageHeader header{type, 0, instance, length};
+  iovec iov[2] = {{&header, sizeof(header)},
+                  {const_cast<void *>(payload), length}};
+  return send_all(fd, iov, length ? 2 : 1);
+}
+
+bool StreamClient::receive_exactly(void *data, std::size_t size) {
+  uint8_t *bytes = static_cast<uint8_t *>(data);
+  while (size > 0) {
+    ssize_t received = recv(fd, bytes, size, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    bytes += received;
+    size -= received;
+  }
+  return true;
+}
+
+bool StreamClient::subscribe(uint16_t instance) {
+  displays[instance] = Frame{};
+  bases[instance] = Frame{};
+  return send_message(MSG_SUBSCRIBE, instance, nullptr, 0);
+}
+
+bool StreamClient::set_key(uint16_t instance, uint8_t key, bool pressed) {
+  uint8_t payload[2] = {key, uint8_t(pressed)};
+  return send_message(MSG_KEY, instance, payload, sizeof(payload));
+}
+
+bool StreamClient::ack(uint16_t instance) {
+  bases[instance] = displays[instance];
+  uint64_t frame_number = frame_numbers[instance];
+  return send_message(MSG_ACK, instance, &frame_number, sizeof(frame_number));
+}
+
+bool StreamClient::request_snapshot(uint16_t instance) {
+  return send_message(MSG_SNAPSHOT, instance, nullptr, 0);
+}
+
+bool StreamClient::restore(uint16_t instance,
+                           const std::vector<uint8_t> &state) {
+  return send_message(MSG_RESTORE, instance, state.data(), state.size());
+}
+
+uint8_t StreamClient::receive(uint16_t &instance, std::vector<uint8_t> &state) {
+  MessageHeader header;
+  if (!receive_exactly(&header, sizeof(header)) ||
+      header.length > MAX_MESSAGE_LENGTH) {
+    return 0;
+  }
+  std::vector<uint8_t> payload(header.length);
+  if (!receive_exactly(payload.data(), payload.size())) {
+    return 0;
+  }
+  instance = header.instance;
+
+  if (header.type == MSG_FRAME) {
+    uint64_t frame_number;
+    uint32_t row_mask;
+    std::memcpy(&frame_number, payload.data(), sizeof(frame_number));
+    std::memcpy(&row_mask, payload.data() + 8, sizeof(row_mask));
+    Frame display = bases[instance];
+    const uint8_t *row = payload.data() + 12;
+    for (int y = 0; y < HEIGHT; y++) {
+      if (row_mask >> y & 1) {
+        std::memcpy(&display[y], row, sizeof(uint64_t));
+        row += sizeof(uint64_t);
+      }
+    }
+    displays[instance] = display;
+    frame_numbers[instance] = frame_number;
+  } else if (header.type == MSG_STATE) {
+    state.swap(payload);
+  }
+  return header.type;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "../chip/chip8.h"
+
+/**
+ * The wire protocol. Every message is an 8-byte header followed by length
+ * bytes of payload, all little endian:
+ *
+ *   uint8 type, uint8 reserved, uint16 instance, uint32 length
+ *
+ * Client to server:
+ *   SUBSCRIBE  start receiving FRAMEs for instance (no payload)
+ *   KEY        uint8 key, uint8 pressed
+ *   ACK        uint64 frame_number: the client now shows that frame
+ *   SNAPSHOT   ask for a STATE reply (no payload)
+ *   RESTORE    a blob from STATE, to load into instance
+ *
+ * Server to client:
+ *   FRAME      uint64 frame_number, uint32 row_mask, then one uint64 per set
+ *              bit of row_mask, lowest row first: the rows that differ from
+ *              the frame the client last ACKed. Before the first ACK, or
+ *              after an ACK for a frame the server no longer remembers,
+ *              every row is sent.
+ *   STATE      a CHIP8::save_state() blob
+ *
+ * So a client keeps two copies of each display: the one it last ACKed,
+ * and that plus the latest FRAME's rows, which is what it shows.
+ */
+const uint8_t MSG_SUBSCRIBE = 0x01;
+const uint8_t MSG_KEY = 0x02;
+const uint8_t MSG_ACK = 0x03;
+const uint8_t MSG_SNAPSHOT = 0x04;
+const uint8_t MSG_RESTORE = 0x05;
+const uint8_t MSG_FRAME = 0x81;
+const uint8_t MSG_STATE = 0x82;
+
+// Anything bigger is a broken or hostile client
+const uint32_t MAX_MESSAGE_LENGTH = 64 * 1024;
+// Unsent bytes the server holds for a client before hanging up on it
+const std::size_t MAX_OUTBOX = 1024 * 1024;
+
+struct MessageHeader {
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t instance;
+  uint32_t length;
+};
+
+static_assert(sizeof(MessageHeader) == 8, "MessageHeader must be packed");
+
+/**
+ * Runs a set of emulator instances and streams them to clients over a
+ * Unix or loopback TCP socket. One thread does everything: step() runs a
+ * frame on every instance and sends each connection one writev() holding
+ * all of its subscribed instances' changes, with changed rows sent straight
+ * from the instances' screens rather than copied.
+ *
+ * Client sockets are non-blocking, so a client that stops reading can't
+ * stall the others. What its socket won't take is kept in its outbox and
+ * sent as it drains, and while there's anything left the client's FRAMEs
+ * are skipped: they're deltas from what it ACKed, so the next one sent
+ * covers those it missed. A client whose outbox outgrows MAX_OUTBOX (a
+ * pile of unread STATE replies) is disconnected.
+ */
+class StreamServer {
+private:
+  struct SentFrame {
+    uint64_t frame_number;
+    Frame screen;
+  };
+
+  // Per connection and instance: what the client is known to show
+  struct Subscription {
+    Frame acked; // the client's base, valid if has_acked
+    bool has_acked = false;
+    std::deque<SentFrame> unacked; // what an ACK may refer to
+  };
+
+  // Frames to remember for ACKs; ~1 s, plenty for a local socket
+  static const std::size_t MAX_UNACKED = 64;
+
+  struct Connection {
+    int fd;
+    std::vector<uint8_t> inbox; // partial messages waiting for more bytes
+    std::vector<uint8_t> outbox; // bytes the socket wouldn't take yet
+    std::map<uint16_t, Subscription> subscriptions;
+  };
+
+  std::vector<CHIP8> instances;
+  std::vector<int> listeners;
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::string unix_path;
+  uint16_t port;
+  std::atomic<bool> running;
+
+  void accept_from(int listener);
+  // false once the connection should be closed
+  bool read_from(Connection &connection);
+  bool handle(Connection &connection, const MessageHeader &header,
+              const uint8_t *payload);
+  bool send_frames(Connection &connection);
+  // Sends what it can now and keeps the rest in the outbox; false once the
+  // connection should be closed
+  bool send_or_queue(Connection &connection, iovec *iov, int count);
+  bool flush(Connection &connection);
+
+public:
+  StreamServer(const std::vector<uint8_t> &rom, int instance_count,
+               int cycles_per_frame = DEFAULT_CYCLES_PER_FRAME,
+               uint64_t seed = 0);
+  ~StreamServer();
+
+  StreamServer(const StreamServer &) = delete;
+  StreamServer &operator=(const StreamServer &) = delete;
+
+  bool listen_unix(const std::string &path);
+  // Loopback only; port 0 picks a free one, which tcp_port() then returns
+  bool listen_tcp(uint16_t port);
+  uint16_t tcp_port() const { return port; }
+
+  // Accepts connections and handles client messages, waiting up to
+  // timeout_ms for something to happen
+  void service(int timeout_ms);
+  // Runs one frame on every instance and streams the changes
+  void step();
+  // service() and step() at 60 fps until stop() from another thread
+  void run();
+  void stop() { running = false; }
+
+  std::size_t connection_count() const { return connections.size(); }
+  CHIP8 &instance(int index) { return instances[index]; }
+};
+
+/**
+ * A minimal blocking client, for tests and as a reference for clients in
+ * other languages. Keeps a copy of each subscribed instance's display.
+ */
+class StreamClient {
+private:
+  int fd;
+  std::map<uint16_t, Frame> bases; // the displays as last ACKed
+  bool send_message(uint8_t type, uint16_t instance, const void *payload,
+                    uint32_t length);
+  bool receive_exactly(void *data, std::size_t size);
+
+public:
+  std::map<uint16_t, Frame> displays;
+  std::map<uint16_t, uint64_t> frame_numbers;
+
+  StreamClient() : fd(-1) {}
+  ~StreamClient();
+
+  StreamClient(const StreamClient &) = delete;
+  StreamClient &operator=(const StreamClient &) = delete;
+
+  bool connect_unix(const std::string &path);
+  bool connect_tcp(uint16_t port);
+
+  bool subscribe(uint16_t instance);
+  bool set_key(uint16_t instance, uint8_t key, bool pressed);
+  bool ack(uint16_t instance);
+  bool request_snapshot(uint16_t instance);
+  bool restore(uint16_t instance, const std::vector<uint8_t> &state);
+
+  /**
+   * Blocks for the next message. FRAMEs are applied to displays; a STATE's
+   * blob is left in state. Returns the message type, or 0 if the
+   * connection closed.
+   */
+  uint8_t receive(uint16_t &instance, std::vector<uint8_t> &state);
+};
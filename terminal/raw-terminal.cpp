@@ -0,0 +1,83 @@
+#include "raw-terminal.h"
+
+#include <cctype>
+#include <cerrno>
+
+#include <unistd.h>
+
+RawTerminal::RawTerminal(int in, int out) : in(in), out(out) {
+  if (tcgetattr(in, &saved) != 0) {
+    return;
+  }
+  termios settings = saved;
+  cfmakeraw(&settings);
+  // keep turning \n into \r\n for anything else that prints
+  settings.c_oflag |= OPOST;
+  // reads return what's there, if anything, rather than waiting. Not
+  // O_NONBLOCK, which stdout would share when both are the same terminal
+  settings.c_cc[VMIN] = 0;
+  settings.c_cc[VTIME] = 0;
+  raw = tcsetattr(in, TCSAFLUSH, &settings) == 0;
+}
+
+RawTerminal::~RawTerminal() {
+  if (raw) {
+    tcsetattr(in, TCSAFLUSH, &saved);
+  }
+}
+
+int RawTerminal::read(char *buffer, int size) {
+  ssize_t got = ::read(in, buffer, size);
+  return got > 0 ? int(got) : 0;
+}
+
+bool RawTerminal::write_all(const std::string &data) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = ::write(out, data.data() + written, data.size() - written);
+    if (n < 0 && errno != EINTR) {
+      return false;
+    }
+    written += n > 0 ? std::size_t(n) : 0;
+  }
+  return true;
+}
+
+int terminal_key(char c) {
+  switch (std::tolower((unsigned char)c)) {
+  case '1':
+    return 0x1;
+  case '2':
+    return 0x2;
+  case '3':
+    return 0x3;
+  case '4':
+    return 0xc;
+  case 'q':
+    return 0x4;
+  case 'w':
+    return 0x5;
+  case 'e':
+    return 0x6;
+  case 'r':
+    return 0xd;
+  case 'a':
+    return 0x7;
+  case 's':
+    return 0x8;
+  case 'd':
+    return 0x9;
+  case 'f':
+    return 0xe;
+  case 'z':
+    return 0xa;
+  case 'x':
+    return 0x0;
+  case 'c':
+    return 0xb;
+  case 'v':
+    return 0xf;
+  default:
+    return -1;
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include <termios.h>
+
+/**
+ * Puts a terminal into raw mode for as long as it lives: no echo, no line
+ * buffering, no signals from Ctrl-C, so every key arrives as bytes as soon
+ * as it's typed. Reads never block, and writes go out whole.
+ */
+class RawTerminal {
+private:
+  int in;
+  int out;
+  termios saved;
+  bool raw = false;
+
+public:
+  RawTerminal(int in = 0, int out = 1);
+  ~RawTerminal();
+
+  RawTerminal(const RawTerminal &) = delete;
+  RawTerminal &operator=(const RawTerminal &) = delete;
+
+  // false if in isn't a terminal
+  bool ok() const { return raw; }
+  // Up to size bytes typed so far, 0 if there are none
+  int read(char *buffer, int size);
+  // Writes all of data, retrying short writes; false on an error
+  bool write_all(const std::string &data);
+};
+
+// The keypad index a typed character stands for, -1 for none: the same
+// 1234/QWER/ASDF/ZXCV block as the window, either case
+int terminal_key(char c);
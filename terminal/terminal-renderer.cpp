@@ -0,0 +1,71 @@
+#include "terminal-renderer.h"
+
+const char *const TerminalRenderer::ENTER = "\x1b[?25l";
+const char *const TerminalRenderer::LEAVE = "\x1b[17;1H\x1b[?25h";
+
+namespace {
+// UTF-8 for nothing, upper half, lower half and full block
+const char *const GLYPHS[4] = {" ", "\xe2\x96\x80", "\xe2\x96\x84",
+                               "\xe2\x96\x88"};
+
+// Cell coordinates and gaps are under 100
+int digits(int n) { return n >= 10 ? 2 : 1; }
+
+void append_number(std::string &out, int n) {
+  if (n >= 10) {
+    out += char('0' + n / 10);
+  }
+  out += char('0' + n % 10);
+}
+} // namespace
+
+void TerminalRenderer::move_to(int row, int column, std::string &out) {
+  if (row == cursor_row && column == cursor_column) {
+    return;
+  }
+  int gap = column - cursor_column;
+  out += "\x1b[";
+  // ESC [ n C against ESC [ row ; column H, counting digits
+  if (row == cursor_row && gap > 0 &&
+      3 + digits(gap) < 4 + digits(row + 1) + digits(column + 1)) {
+    append_number(out, gap);
+    out += 'C';
+  } else {
+    append_number(out, row + 1);
+    out += ';';
+    append_number(out, column + 1);
+    out += 'H';
+  }
+  cursor_row = row;
+  cursor_column = column;
+}
+
+void TerminalRenderer::render(const Frame &screen, std::string &out) {
+  if (!drawn) {
+    // a cleared terminal shows a blank frame, so only lit cells follow
+    out += "\x1b[2J";
+    shown.fill(0);
+    cursor_row = cursor_column = -1;
+  }
+  for (int row = 0; row < TERMINAL_ROWS; row++) {
+    uint64_t top = screen[2 * row];
+    uint64_t bottom = screen[2 * row + 1];
+    uint64_t changed = (top ^ shown[2 * row]) | (bottom ^ shown[2 * row + 1]);
+    while (changed) {
+      // bit 63 is the leftmost pixel
+      int column = __builtin_clzll(changed);
+      int shift = WIDTH - 1 - column;
+      changed &= ~(1ull << shift);
+      move_to(row, column, out);
+      out += GLYPHS[(top >> shift & 1) | (bottom >> shift & 1) << 1];
+      // the cursor moves on by one, except from the last column, after
+      // which terminals disagree on where it is
+      cursor_column = column + 1;
+      if (cursor_column == TERMINAL_COLUMNS) {
+        cursor_row = cursor_column = -1;
+      }
+    }
+  }
+  shown = screen;
+  drawn = true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "../chip/chip8.h"
+
+// Character cells: each shows a pixel above another with a half block
+const int TERMINAL_COLUMNS = WIDTH;
+const int TERMINAL_ROWS = HEIGHT / 2;
+
+/**
+ * Turns frames into ANSI/UTF-8 output for a terminal, for hosts with no
+ * display (e.g. over SSH). Each character cell holds two pixels, drawn as
+ * ' ', '▀', '▄' or '█', so the display fits in 64x16 cells.
+ *
+ * Only cells that differ from the last frame rendered are written, found a
+ * 64-bit row pair at a time. Between changed cells the cursor moves with
+ * whichever is shorter of a forward move on the same row and an absolute
+ * position, and not at all for neighbouring cells, so a frame where a
+ * paddle moves is a few dozen bytes. The output for a frame is meant to be
+ * written with one write() call.
+ */
+class TerminalRenderer {
+private:
+  Frame shown;
+  bool drawn = false;
+  // 0-based cell the terminal's cursor is on, as far as we know
+  int cursor_row = -1;
+  int cursor_column = -1;
+
+  void move_to(int row, int column, std::string &out);
+
+public:
+  // Hides the cursor; the first render() clears the screen
+  static const char *const ENTER;
+  // Shows the cursor and puts it under the display
+  static const char *const LEAVE;
+
+  /**
+   * Appends what turns the last frame rendered into screen to out, nothing
+   * if they're equal. The first call, and the first after invalidate(),
+   * clears the terminal and draws every lit cell.
+   */
+  void render(const Frame &screen, std::string &out);
+  // Redraws in full next time, e.g. after the terminal was resized
+  void invalidate() { drawn = false; }
+};
@@ -0,0 +1,142 @@
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../emu-thread/emu-thread.h"
+#include "../input-queue/input-queue.h"
+#include "../triple-buffer/triple-buffer.h"
+#include "raw-terminal.h"
+#include "terminal-renderer.h"
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Terminals send key presses but no releases, so a key counts as held until
+// this long after its last byte; autorepeat keeps a held key down
+const int DEFAULT_KEY_HOLD_MS = 150;
+const char CTRL_C = 3;
+const char ESCAPE = 27;
+
+volatile std::sig_atomic_t resized = 0;
+
+void on_resize(int) { resized = 1; }
+} // namespace
+
+// Plays a ROM in the terminal, for hosts without a display, e.g. over SSH:
+//   ./terminal_bin ../demo-roms/pong.ch8
+// The display takes 64x16 character cells. Keys are the window's
+// 1234/QWER/ASDF/ZXCV block; Esc or Ctrl-C quits. There's no sound.
+int main(int argc, char *argv[]) {
+  int cycle_delay = 2;
+  int hold_ms = DEFAULT_KEY_HOLD_MS;
+  bool vip_quirks = false;
+  bool vip_timing = false;
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--delay" && has_value) {
+      cycle_delay = std::atoi(argv[++i]);
+    } else if (arg == "--hold" && has_value) {
+      hold_ms = std::atoi(argv[++i]);
+    } else if (arg == "--vip") {
+      vip_quirks = true;
+    } else if (arg == "--vip-timing") {
+      vip_timing = true;
+    } else if (path.empty() && arg.compare(0, 2, "--") != 0) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+  if (path.empty() || cycle_delay <= 0 || hold_ms <= 0) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--delay <ms>] [--hold <ms>] [--vip] [--vip-timing] <ROM>"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  CHIP8 chip;
+  if (vip_quirks) {
+    chip.quirks = Quirks::cosmac_vip();
+  }
+  chip.vip_timing = vip_timing;
+  if (!chip.load_rom(path)) {
+    std::cerr << "Can't load " << path << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  RawTerminal terminal;
+  if (!terminal.ok()) {
+    std::cerr << "Standard input isn't a terminal" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::signal(SIGWINCH, on_resize);
+
+  InputQueue input;
+  TripleBuffer<Frame> frames;
+  EmulatorThread emulator(chip, input, frames,
+                          1000.0 / cycle_delay / FRAMES_PER_SECOND);
+
+  TerminalRenderer renderer;
+  std::string out = TerminalRenderer::ENTER;
+  const std::chrono::milliseconds hold(hold_ms);
+  std::array<bool, 16> held{};
+  std::array<Clock::time_point, 16> release_at;
+
+  bool quit = false;
+  while (!quit) {
+    char typed[64];
+    int count = terminal.read(typed, sizeof(typed));
+    auto now = Clock::now();
+    for (int i = 0; i < count; i++) {
+      if (typed[i] == CTRL_C || (typed[i] == ESCAPE && i + 1 == count)) {
+        quit = true;
+      } else if (typed[i] == ESCAPE) {
+        // arrow keys and the like: ESC [ or O, parameters, a final letter
+        for (i += 2; i < count && (typed[i] < '@' || typed[i] > '~'); i++) {
+        }
+        continue;
+      }
+      int key = terminal_key(typed[i]);
+      if (key < 0) {
+        continue;
+      }
+      if (!held[key]) {
+        input.push(key, true);
+        held[key] = true;
+      }
+      release_at[key] = now + hold;
+    }
+    for (int key = 0; key < 16; key++) {
+      if (held[key] && now >= release_at[key]) {
+        input.push(key, false);
+        held[key] = false;
+      }
+    }
+
+    if (resized) {
+      resized = 0;
+      renderer.invalidate();
+    }
+    if (frames.acquire()) {
+      renderer.render(frames.read_buffer(), out);
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // one write per frame; a slow link makes this block, and frames the
+    // emulator thread publishes meanwhile are skipped rather than queued
+    if (!out.empty()) {
+      quit = quit || !terminal.write_all(out);
+      out.clear();
+    }
+  }
+
+  emulator.stop();
+  terminal.write_all(TerminalRenderer::LEAVE);
+}
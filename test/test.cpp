@@ -24,12 +24,67 @@ TEST_F(CHIP8Test, TestRegistersInit) {
   }
 }
 
+TEST_F(CHIP8Test, TestResetIsPowerOn) {
+  CHIP8 fresh;
+  uint8_t rom[] = {0x60, 0x01, 0x12, 0x02}; // V0 = 1, then spin
+  ASSERT_TRUE(chip.load_rom(rom, sizeof(rom)));
+  chip.stack.push_back(0x300);
+  chip.delay_timer = 5;
+  chip.sound_timer = 6;
+  chip.set_key(2, true);
+  chip.address_i = 0x123;
+  chip.run_until(3);
+
+  chip.reset();
+  ASSERT_EQ(chip.state_digest(), fresh.state_digest());
+  ASSERT_EQ(chip.state_hash(), fresh.state_hash());
+  ASSERT_EQ(chip.frame_number, 0u);
+  const CHIP8 &view = chip;
+  ASSERT_EQ(view.memory[START_ADDRESS], 0);
+}
+
+TEST_F(CHIP8Test, TestCallStackDropsTheOldest) {
+  for (WORD level = 0; level < CALL_STACK_DEPTH; level++) {
+    chip.stack.push_back(0x200 + level);
+  }
+  ASSERT_EQ(chip.stack.size(), CALL_STACK_DEPTH);
+  ASSERT_FALSE(chip.stack.empty());
+  // the 17th call dropped the oldest return address
+  chip.stack.push_back(0x200 + CALL_STACK_DEPTH);
+  ASSERT_EQ(chip.stack.size(), CALL_STACK_DEPTH);
+  ASSERT_EQ(chip.stack[0], 0x201);
+  ASSERT_EQ(chip.stack.back(), 0x200 + CALL_STACK_DEPTH);
+  chip.stack.pop_back();
+  ASSERT_EQ(chip.stack.back(), 0x200 + CALL_STACK_DEPTH - 1);
+}
+
+TEST_F(CHIP8Test, TestFullCallStackRoundTrips) {
+  for (WORD level = 0; level < CALL_STACK_DEPTH; level++) {
+    chip.stack.push_back(0x300 + 2 * level);
+  }
+  CHIP8 empty = chip;
+  empty.stack.clear();
+  ASSERT_NE(chip.state_hash(), empty.state_hash());
+  ASSERT_NE(chip.state_digest(), empty.state_digest());
+
+  std::vector<uint8_t> state;
+  chip.save_state(state);
+  CHIP8 restored;
+  ASSERT_TRUE(restored.restore_state(state.data(), state.size()));
+  ASSERT_EQ(restored.stack.size(), CALL_STACK_DEPTH);
+  ASSERT_EQ(restored.state_hash(), chip.state_hash());
+  // the next 00EE returns to the innermost call
+  restored.opcode = 0x00ee;
+  restored.OP_00EE();
+  ASSERT_EQ(restored.program_counter, 0x300 + 2 * (CALL_STACK_DEPTH - 1));
+}
+
 TEST_F(CHIP8Test, TestOP_00E0) {
   chip.opcode = 0x00e0;
   chip.OP_00E0();
   for (int y = 0; y < 32; y++) {
     for (int x = 0; x < 64; x++) {
-      ASSERT_EQ(chip.screen[y][x], 0);
+      ASSERT_EQ(chip.pixel(x, y), 0);
     }
     std::cout << std::endl;
   }
@@ -253,12 +308,13 @@ TEST_F(CHIP8Test, TestOP_8XY5) {
   ASSERT_EQ(chip.registers[0], 0xfe);
   ASSERT_EQ(chip.registers[0xf], 0x1);
 
+  // equal operands don't borrow
   chip.registers[0] = 0xff;
   chip.registers[1] = 0xff;
   chip.opcode = 0x8015;
   chip.OP_8XY5();
   ASSERT_EQ(chip.registers[0], 0x00);
-  ASSERT_EQ(chip.registers[0xf], 0x0);
+  ASSERT_EQ(chip.registers[0xf], 0x1);
 
   chip.registers[0] = 0x00;
   chip.registers[1] = 0x01;
@@ -298,12 +354,13 @@ TEST_F(CHIP8Test, TestOP_8XY7) {
   ASSERT_EQ(chip.registers[0], 0b00000010);
   ASSERT_EQ(chip.registers[0xf], 0x0);
 
+  // equal operands don't borrow
   chip.registers[0] = 0xff;
   chip.registers[1] = 0xff;
   chip.opcode = 0x8017;
   chip.OP_8XY7();
   ASSERT_EQ(chip.registers[0], 0x0);
-  ASSERT_EQ(chip.registers[0xf], 0x0);
+  ASSERT_EQ(chip.registers[0xf], 0x1);
 
   chip.registers[0] = 0x00;
   chip.registers[1] = 0x01;
@@ -373,6 +430,55 @@ TEST_F(CHIP8Test, TestOP_CXKK) {
   ASSERT_EQ(chip.registers[0], 0);
 }
 
+TEST_F(CHIP8Test, TestOP_CXKKSeeded) {
+  CHIP8 other = CHIP8();
+  chip.seed(1234);
+  other.seed(1234);
+  chip.opcode = 0xc0ff;
+  other.opcode = 0xc0ff;
+  std::array<int, 256> counts{};
+  for (int i = 0; i < 256 * 64; i++) {
+    chip.OP_CXKK();
+    other.OP_CXKK();
+    ASSERT_EQ(chip.registers[0], other.registers[0]);
+    counts[chip.registers[0]]++;
+  }
+  // every value turns up, none wildly more often than the 64 expected
+  for (int count : counts) {
+    ASSERT_GT(count, 16);
+    ASSERT_LT(count, 160);
+  }
+
+  // kk masks the byte
+  chip.opcode = 0xc00f;
+  for (int i = 0; i < 64; i++) {
+    chip.OP_CXKK();
+    ASSERT_EQ(chip.registers[0] & 0xf0, 0);
+  }
+}
+
+TEST_F(CHIP8Test, TestOP_CXKKReplay) {
+  RecordingSource recording(42);
+  chip.random_source = &recording;
+  chip.opcode = 0xc3ff;
+  std::vector<BYTE> drawn;
+  for (int i = 0; i < 100; i++) {
+    chip.OP_CXKK();
+    drawn.push_back(chip.registers[3]);
+  }
+  ASSERT_EQ(recording.bytes, drawn);
+
+  CHIP8 replay = CHIP8();
+  ReplaySource source(recording.bytes);
+  replay.random_source = &source;
+  replay.opcode = 0xc3ff;
+  for (int i = 0; i < 100; i++) {
+    replay.OP_CXKK();
+    ASSERT_EQ(replay.registers[3], drawn[i]);
+  }
+  ASSERT_TRUE(source.exhausted());
+}
+
 TEST_F(CHIP8Test, TestOP_DXYN) {
   // test char '0'
   chip.address_i = 0x50; // address of char '0'
@@ -382,7 +488,7 @@ TEST_F(CHIP8Test, TestOP_DXYN) {
   BYTE sprite_pixel;
   for (int y = 0; y < 5; y++) {
     for (int x = 0; x < 8; x++) {
-      screen_pixel = chip.screen[y][x];
+      screen_pixel = chip.pixel(x, y);
       sprite_pixel = fontset[y] & (0b10000000 >> x);
       sprite_pixel >>= (8 - x - 1);
       // std::cout << "Screen: " << (int) screen_pixel << " sprite: " << (int)
@@ -402,7 +508,7 @@ TEST_F(CHIP8Test, TestOP_DXYN) {
   chip.OP_DXYN();
   for (int y = 0; y < 5; y++) {
     for (int x = 0; x < 8; x++) {
-      screen_pixel = chip.screen[y][x];
+      screen_pixel = chip.pixel(x, y);
       sprite_pixel = fontset[y + 5] & (0b10000000 >> x);
       sprite_pixel >>= (8 - x - 1);
       if (sprite_pixel) {
@@ -419,7 +525,7 @@ TEST_F(CHIP8Test, TestOP_DXYN) {
   chip.OP_DXYN();
   for (int y = 0; y < 5; y++) {
     for (int x = 0; x < 8; x++) {
-      screen_pixel = chip.screen[y][x];
+      screen_pixel = chip.pixel(x, y);
       sprite_pixel = fontset[y + 5] & (0b10000000 >> x);
       sprite_pixel >>= (8 - x - 1);
       if (sprite_pixel) {
@@ -566,3 +672,170 @@ TEST_F(CHIP8Test, TestOP_FX65) {
   ASSERT_EQ(chip.registers[5], 0x01);
   ASSERT_EQ(chip.registers[6], 0xff);
 }
+
+TEST_F(CHIP8Test, TestOP_DXYNClipsAtEdges) {
+  chip.address_i = 0x50; // char '0', 0xF0 0x90 0x90 0x90 0xF0
+  chip.registers[0] = 62;
+  chip.registers[1] = 30;
+  chip.opcode = 0xd015;
+  chip.OP_DXYN();
+
+  // only the top-left 2x2 corner of the glyph is visible
+  ASSERT_EQ(chip.pixel(62, 30), 0xffffffff);
+  ASSERT_EQ(chip.pixel(63, 30), 0xffffffff);
+  ASSERT_EQ(chip.pixel(62, 31), 0xffffffff);
+  ASSERT_EQ(chip.pixel(63, 31), 0);
+  // nothing wrapped around to the left or top
+  for (int x = 0; x < 8; x++) {
+    ASSERT_EQ(chip.pixel(x, 0), 0);
+    ASSERT_EQ(chip.pixel(x, 31), 0);
+  }
+  ASSERT_EQ(chip.registers[0xf], 0);
+}
+
+TEST_F(CHIP8Test, TestTimersTickPerFrame) {
+  chip.delay_timer = 2;
+  chip.sound_timer = 1;
+  chip.memory[0x200] = 0x60; // LD V0, 0
+  chip.memory[0x201] = 0x00;
+  chip.cycle();
+  ASSERT_EQ(chip.delay_timer, 2);
+  ASSERT_EQ(chip.sound_timer, 1);
+
+  chip.tick_timers();
+  ASSERT_EQ(chip.delay_timer, 1);
+  ASSERT_EQ(chip.sound_timer, 0);
+  chip.tick_timers();
+  chip.tick_timers();
+  ASSERT_EQ(chip.delay_timer, 0);
+  ASSERT_EQ(chip.sound_timer, 0);
+}
+
+TEST_F(CHIP8Test, TestOP_DXYNMatchesPixelLoop) {
+  // every height at every position, against a straightforward per-pixel
+  // version that clips at the edges
+  for (int i = 0; i < 16; i++) {
+    chip.memory[0x300 + i] = (BYTE)(0x5a * (i + 1) ^ (i << 3));
+  }
+  chip.address_i = 0x300;
+  chip.registers[1] = 0;
+
+  for (int height = 0; height < 16; height++) {
+    for (int y_pos = 0; y_pos < HEIGHT; y_pos++) {
+      for (int x_pos = 0; x_pos < WIDTH; x_pos++) {
+        chip.reset_screen();
+        for (int y = 0; y < HEIGHT; y++) {
+          chip.screen[y] = 0x9e3779b97f4a7c15ull * (y + height + 1);
+        }
+        Frame expected = chip.screen;
+        bool collision = false;
+        for (int y = 0; y < height && y_pos + y < HEIGHT; y++) {
+          for (int x = 0; x < 8 && x_pos + x < WIDTH; x++) {
+            if (chip.memory[0x300 + y] & (0x80 >> x)) {
+              uint64_t bit = 1ull << (WIDTH - 1 - (x_pos + x));
+              collision |= (expected[y_pos + y] & bit) != 0;
+              expected[y_pos + y] ^= bit;
+            }
+          }
+        }
+
+        chip.registers[0x2] = x_pos;
+        chip.registers[0x3] = y_pos;
+        chip.opcode = 0xd230 | height;
+        chip.OP_DXYN();
+        ASSERT_EQ(chip.screen, expected)
+            << "height " << height << " at " << x_pos << "," << y_pos;
+        ASSERT_EQ(chip.registers[0xf], collision ? 1 : 0);
+      }
+    }
+  }
+}
+
+namespace {
+
+struct AluCase {
+  WORD op;
+  // expected Vx and VF from the operands and the VF value going in
+  int (*result)(int x, int y, bool shift_uses_vy);
+  int (*flag)(int x, int y, int vf, bool shift_uses_vy, bool logic_resets_vf);
+};
+
+const AluCase alu_cases[] = {
+    {0x1, [](int x, int y, bool) { return x | y; },
+     [](int, int, int vf, bool, bool reset) { return reset ? 0 : vf; }},
+    {0x2, [](int x, int y, bool) { return x & y; },
+     [](int, int, int vf, bool, bool reset) { return reset ? 0 : vf; }},
+    {0x3, [](int x, int y, bool) { return x ^ y; },
+     [](int, int, int vf, bool, bool reset) { return reset ? 0 : vf; }},
+    {0x4, [](int x, int y, bool) { return (x + y) % 256; },
+     [](int x, int y, int, bool, bool) { return x + y > 255 ? 1 : 0; }},
+    {0x5, [](int x, int y, bool) { return (x - y + 256) % 256; },
+     [](int x, int y, int, bool, bool) { return x >= y ? 1 : 0; }},
+    {0x6, [](int x, int y, bool vy) { return (vy ? y : x) >> 1; },
+     [](int x, int y, int, bool vy, bool) { return (vy ? y : x) & 1; }},
+    {0x7, [](int x, int y, bool) { return (y - x + 256) % 256; },
+     [](int x, int y, int, bool, bool) { return y >= x ? 1 : 0; }},
+    {0xe, [](int x, int y, bool vy) { return ((vy ? y : x) << 1) % 256; },
+     [](int x, int y, int, bool vy, bool) { return (vy ? y : x) >> 7; }},
+};
+
+} // namespace
+
+TEST_F(CHIP8Test, TestALUExhaustive) {
+  // every operand pair for every 8XYn op that sets a flag, in both quirk
+  // modes, checked against the plain arithmetic definitions
+  for (bool vip : {false, true}) {
+    chip.quirks = vip ? Quirks::cosmac_vip() : Quirks();
+    for (const AluCase &alu : alu_cases) {
+      chip.opcode = 0x8120 | alu.op; // X = 1, Y = 2
+      for (int x = 0; x < 256; x++) {
+        for (int y = 0; y < 256; y++) {
+          const int vf = (x ^ y) & 1;
+          chip.registers[1] = x;
+          chip.registers[2] = y;
+          chip.registers[0xf] = vf;
+          (chip.*chip.table8[alu.op])();
+          ASSERT_EQ(chip.registers[1],
+                    alu.result(x, y, chip.quirks.shift_uses_vy))
+              << std::hex << "op " << alu.op << " x " << x << " y " << y;
+          ASSERT_EQ(chip.registers[0xf],
+                    alu.flag(x, y, vf, chip.quirks.shift_uses_vy,
+                             chip.quirks.logic_resets_vf))
+              << std::hex << "op " << alu.op << " x " << x << " y " << y;
+          ASSERT_EQ(chip.registers[2], y);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(CHIP8Test, TestALUFlagWinsInVF) {
+  // with X = F the flag is written last, so the result is lost
+  for (bool vip : {false, true}) {
+    chip.quirks = vip ? Quirks::cosmac_vip() : Quirks();
+    for (const AluCase &alu : alu_cases) {
+      if (alu.op <= 0x3) {
+        continue;
+      }
+      chip.opcode = 0x8f30 | alu.op; // X = F, Y = 3
+      for (int x = 0; x < 256; x++) {
+        for (int y = 0; y < 256; y += 7) {
+          chip.registers[0xf] = x;
+          chip.registers[3] = y;
+          (chip.*chip.table8[alu.op])();
+          ASSERT_EQ(chip.registers[0xf],
+                    alu.flag(x, y, x, chip.quirks.shift_uses_vy, false))
+              << std::hex << "op " << alu.op << " x " << x << " y " << y;
+        }
+      }
+
+      // and with Y = F the operand is read before VF is overwritten
+      chip.opcode = 0x83f0 | alu.op;
+      chip.registers[3] = 0x81;
+      chip.registers[0xf] = 0xc3;
+      (chip.*chip.table8[alu.op])();
+      ASSERT_EQ(chip.registers[3],
+                alu.result(0x81, 0xc3, chip.quirks.shift_uses_vy));
+    }
+  }
+}
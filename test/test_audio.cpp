@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+#include "../audio/audio.h"
+#include "../chip/chip8.h"
+
+TEST(BeeperTest, TestSilentWhenGateClosed) {
+  Beeper beeper;
+  std::vector<int16_t> out(1000, 1);
+  beeper.render(false, out.data(), out.size());
+  for (auto sample : out) {
+    ASSERT_EQ(sample, 0);
+  }
+}
+
+TEST(BeeperTest, TestSquareWaveAfterFadeIn) {
+  // 256 Hz at 32768 Hz is exactly one pattern bit per sample: a 128 sample
+  // period, 64 high then 64 low
+  Beeper beeper(32768, 256);
+  std::vector<int16_t> out(400);
+  beeper.render(true, out.data(), out.size());
+
+  // fades in, never jumping to full volume
+  ASSERT_LT(std::abs(out[0]), AUDIO_AMPLITUDE / 10);
+  for (int i = 1; i < AUDIO_RAMP_SAMPLES; i++) {
+    ASSERT_LE(std::abs(out[i]), AUDIO_AMPLITUDE);
+    ASSERT_GE(std::abs(out[i]), std::abs(out[i - 1]));
+  }
+
+  for (int i = AUDIO_RAMP_SAMPLES; i < 400; i++) {
+    int16_t expected = (i % 128) < 64 ? AUDIO_AMPLITUDE : -AUDIO_AMPLITUDE;
+    ASSERT_EQ(out[i], expected);
+  }
+}
+
+TEST(BeeperTest, TestFadeOutIsClickFree) {
+  Beeper beeper;
+  std::vector<int16_t> out(500);
+  beeper.render(true, out.data(), out.size());
+  beeper.render(false, out.data(), out.size());
+
+  for (int i = 1; i < AUDIO_RAMP_SAMPLES; i++) {
+    ASSERT_LE(std::abs(out[i]), std::abs(out[i - 1]));
+  }
+  for (std::size_t i = AUDIO_RAMP_SAMPLES; i < out.size(); i++) {
+    ASSERT_EQ(out[i], 0);
+  }
+}
+
+TEST(AudioStreamTest, TestSoundTimerDrivesTone) {
+  NullAudioSink sink;
+  AudioStream audio(sink);
+  CHIP8 chip;
+
+  // LD V0, 3; LD ST, V0; JP 0x204
+  const BYTE program[] = {0x60, 0x03, 0xf0, 0x18, 0x12, 0x04};
+  chip.load_rom(program, sizeof(program));
+
+  const int frames = 6;
+  for (int frame = 0; frame < frames; frame++) {
+    chip.cycle();
+    audio.frame(chip.sound_timer > 0);
+    chip.tick_timers();
+  }
+
+  const std::size_t per_frame = AUDIO_SAMPLE_RATE / FRAMES_PER_SECOND;
+  ASSERT_EQ(sink.samples.size(), per_frame * frames);
+
+  auto peak = [&](int frame) {
+    int loudest = 0;
+    for (std::size_t i = frame * per_frame; i < (frame + 1) * per_frame; i++) {
+      loudest = std::max(loudest, std::abs((int)sink.samples[i]));
+    }
+    return loudest;
+  };
+  // sound timer is 0 in frame 0 (LD V0 runs), then 3, 2, 1, then 0 again
+  ASSERT_EQ(peak(0), 0);
+  ASSERT_EQ(peak(1), AUDIO_AMPLITUDE);
+  ASSERT_EQ(peak(2), AUDIO_AMPLITUDE);
+  ASSERT_EQ(peak(3), AUDIO_AMPLITUDE);
+  ASSERT_GT(peak(4), 0); // fading out
+  ASSERT_EQ(peak(5), 0);
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../chip/chip8_c.h"
+
+// Built into its own executable that links only libchip8.so, so this sees
+// just what the library exports, as an FFI caller would
+
+namespace {
+// Draws font digit V0 at (V1, V2), bumps V0 while key 5 is down, clears
+// and loops; the same ROM as test_embedding.cpp
+const std::vector<uint8_t> rom = {0x65, 0x05, 0xf0, 0x29, 0xd1, 0x25, 0xe5,
+                                  0xa1, 0x70, 0x01, 0x00, 0xe0, 0x12, 0x02};
+} // namespace
+
+TEST(CApiTest, SharesTheDisplay) {
+  chip8 *chip = chip8_create(1);
+  ASSERT_EQ(chip8_load_rom(chip, rom.data(), rom.size()), 1);
+  const uint64_t *view = chip8_frame_view(chip);
+
+  // stop right after the DRW: digit 0 (top and bottom rows 0xF0) at (0, 0)
+  chip8_step(chip, 3);
+  ASSERT_EQ(view[0] >> 56, uint64_t(0xf0));
+  ASSERT_EQ(view[4] >> 56, uint64_t(0xf0));
+
+  // same pointer, now showing the CLS
+  chip8_step(chip, 2);
+  ASSERT_EQ(chip8_frame_view(chip), view);
+  ASSERT_EQ(view[0], 0u);
+
+  chip8_set_key(chip, 5, 1);
+  chip8_set_cycles_per_frame(chip, 9);
+  chip8_run_until(chip, 1);
+  ASSERT_EQ(chip8_frame_number(chip), 1u);
+  // the key was seen, so the loop came round again and drew digit 1, whose
+  // top row is 0x20
+  ASSERT_EQ(view[0] >> 56, uint64_t(0x20));
+
+  chip8 *other = chip8_create(1);
+  ASSERT_NE(chip8_state_digest(chip), chip8_state_digest(other));
+  chip8_destroy(other);
+  chip8_destroy(chip);
+}
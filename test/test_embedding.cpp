@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+namespace {
+// Draws font digit V0 at (V1, V2), bumps V0 while key 5 is down, clears
+// and loops:
+//   200: 6505  LD V5, 5
+//   202: F029  LD F, V0
+//   204: D125  DRW V1, V2, 5
+//   206: E5A1  SKNP V5
+//   208: 7001  ADD V0, 1
+//   20A: 00E0  CLS
+//   20C: 1202  JP 202
+const std::vector<uint8_t> rom = {0x65, 0x05, 0xf0, 0x29, 0xd1, 0x25, 0xe5,
+                                  0xa1, 0x70, 0x01, 0x00, 0xe0, 0x12, 0x02};
+} // namespace
+
+TEST(EmbeddingTest, RunUntilCountsFrames) {
+  CHIP8 chip = CHIP8();
+  ASSERT_TRUE(chip.load_rom(rom.data(), rom.size()));
+  chip.delay_timer = 10;
+  chip.run_until(4);
+  ASSERT_EQ(chip.frame_number, 4u);
+  ASSERT_EQ(chip.delay_timer, 6);
+  // already there: nothing runs
+  WORD pc = chip.program_counter;
+  chip.run_until(2);
+  ASSERT_EQ(chip.program_counter, pc);
+}
+
+TEST(EmbeddingTest, StepDoesNotTickTimers) {
+  CHIP8 chip = CHIP8();
+  chip.load_rom(rom.data(), rom.size());
+  chip.delay_timer = 10;
+  chip.step(3);
+  ASSERT_EQ(chip.program_counter, 0x206);
+  ASSERT_EQ(chip.delay_timer, 10);
+  ASSERT_EQ(chip.frame_number, 0u);
+}
+
+TEST(EmbeddingTest, RejectsOversizedRom) {
+  CHIP8 chip = CHIP8();
+  std::vector<uint8_t> big(4096 - START_ADDRESS + 1, 0xaa);
+  ASSERT_FALSE(chip.load_rom(big.data(), big.size()));
+  big.pop_back();
+  ASSERT_TRUE(chip.load_rom(big.data(), big.size()));
+  ASSERT_FALSE(chip.load_rom("does/not/exist.ch8"));
+}
+
+TEST(EmbeddingTest, DigestTracksState) {
+  CHIP8 a = CHIP8();
+  CHIP8 b = CHIP8();
+  ASSERT_EQ(a.state_digest(), b.state_digest());
+  a.load_rom(rom.data(), rom.size());
+  b.load_rom(rom.data(), rom.size());
+  a.run_until(3);
+  b.run_until(3);
+  ASSERT_EQ(a.state_digest(), b.state_digest());
+
+  b.set_key(5, true);
+  ASSERT_NE(a.state_digest(), b.state_digest());
+  b.set_key(5, false);
+  ASSERT_EQ(a.state_digest(), b.state_digest());
+
+  b.stack.push_back(0);
+  ASSERT_NE(a.state_digest(), b.state_digest());
+}
+
+TEST(EmbeddingTest, IncrementalHashMatchesRehash) {
+  for (const char *name : {"pong.ch8", "tetris.ch8", "test_opcode.ch8"}) {
+    SCOPED_TRACE(name);
+    CHIP8 chip = CHIP8();
+    chip.seed(3);
+    ASSERT_TRUE(chip.load_rom(std::string(CHIP8_ROM_DIR) + "/" + name));
+    for (int frame = 0; frame < 200; frame++) {
+      chip.set_key(frame % 16, frame % 3 == 0);
+      chip.run_frame();
+      uint64_t incremental = chip.state_hash();
+      chip.rehash();
+      ASSERT_EQ(chip.state_hash(), incremental) << "frame " << frame;
+    }
+  }
+}
+
+TEST(EmbeddingTest, HashTracksState) {
+  CHIP8 a = CHIP8();
+  CHIP8 b = CHIP8();
+  ASSERT_EQ(a.state_hash(), b.state_hash());
+  a.load_rom(rom.data(), rom.size());
+  ASSERT_NE(a.state_hash(), b.state_hash());
+  b.load_rom(rom.data(), rom.size());
+  a.run_until(3);
+  b.run_until(3);
+  ASSERT_EQ(a.state_hash(), b.state_hash());
+
+  // memory and screen differences count, not just the registers
+  b.memory[0x300] = 1;
+  b.rehash();
+  ASSERT_NE(a.state_hash(), b.state_hash());
+  b.memory[0x300] = 0;
+  b.rehash();
+  ASSERT_EQ(a.state_hash(), b.state_hash());
+  b.screen[31] ^= 1;
+  ASSERT_NE(a.state_hash(), b.state_hash());
+
+  b.set_key(5, true);
+  ASSERT_NE(a.state_hash(), b.state_hash());
+  b.set_key(5, false);
+
+  std::vector<uint8_t> state;
+  a.save_state(state);
+  CHIP8 c = CHIP8();
+  ASSERT_TRUE(c.restore_state(state.data(), state.size()));
+  ASSERT_EQ(c.state_hash(), a.state_hash());
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../explorer/explorer.h"
+
+namespace {
+CHIP8 load(std::initializer_list<uint8_t> rom) {
+  CHIP8 chip;
+  chip.seed(0);
+  std::vector<uint8_t> bytes(rom);
+  EXPECT_TRUE(chip.load_rom(bytes.data(), bytes.size()));
+  return chip;
+}
+
+// calls nested calls, each instruction calling the next, then spins
+CHIP8 nested_calls(int calls) {
+  CHIP8 chip;
+  chip.seed(0);
+  std::vector<uint8_t> rom;
+  for (int call = 0; call < calls; call++) {
+    WORD target = START_ADDRESS + 2 * (call + 1);
+    rom.push_back(0x20 | target >> 8);
+    rom.push_back(target & 0xff);
+  }
+  WORD spin = START_ADDRESS + 2 * calls;
+  rom.push_back(0x10 | spin >> 8);
+  rom.push_back(spin & 0xff);
+  EXPECT_TRUE(chip.load_rom(rom.data(), rom.size()));
+  return chip;
+}
+
+ExploreOptions small() {
+  ExploreOptions options;
+  options.threads = 2;
+  options.segment_frames = 5;
+  return options;
+}
+} // namespace
+
+TEST(ExplorerTest, FindsTheInputThatFaults) {
+  CHIP8 chip = load({
+      0xf0, 0x0a, // 200: V0 = key, waiting for one
+      0x30, 0x05, // 202: skip the spin if V0 == 5
+      0x12, 0x04, // 204: spin
+      0x00, 0xee, // 206: return with nothing to return to
+  });
+  ExploreReport report = explore(chip, small());
+  ASSERT_FALSE(report.truncated);
+  ASSERT_EQ(report.faults.size(), 1u);
+  const Fault &fault = report.faults[0];
+  ASSERT_EQ(fault.reason, "return with an empty stack");
+  ASSERT_EQ(fault.pc, 0x206);
+  ASSERT_EQ(fault.inputs.size(), 1u);
+  ASSERT_EQ(fault.inputs[0].key, 5);
+  for (int address = 0x200; address < 0x206; address++) {
+    ASSERT_TRUE(report.reached[address]) << address;
+  }
+  ASSERT_FALSE(report.reached[0x206]);
+}
+
+TEST(ExplorerTest, PollingLoopsEndByDeduplication) {
+  CHIP8 chip = load({
+      0xe0, 0xa1, // 200: skip unless key V0 (0) is held
+      0x12, 0x00, // 202: poll again
+      0x71, 0x01, // 204: count the press
+      0x12, 0x00, // 206: and poll again
+  });
+  ExploreOptions options = small();
+  options.max_depth = 1000;
+  ExploreReport report = explore(chip, options);
+  ASSERT_FALSE(report.truncated);
+  ASSERT_GT(report.duplicates, 0u);
+  // V1 wraps after 256 presses; the rest is the key and the frame position
+  ASSERT_LE(report.states, 2 * 256u * DEFAULT_CYCLES_PER_FRAME);
+  ASSERT_TRUE(report.faults.empty());
+}
+
+TEST(ExplorerTest, SeventeenthNestedCallOverflows) {
+  ExploreReport full = explore(nested_calls(CALL_STACK_DEPTH), small());
+  ASSERT_TRUE(full.faults.empty());
+
+  ExploreReport over = explore(nested_calls(CALL_STACK_DEPTH + 1), small());
+  ASSERT_EQ(over.faults.size(), 1u);
+  ASSERT_EQ(over.faults[0].reason, "call stack overflow");
+  ASSERT_EQ(over.faults[0].pc, START_ADDRESS + 2 * CALL_STACK_DEPTH);
+}
+
+TEST(ExplorerTest, ResultsDontDependOnThreads) {
+  CHIP8 chip;
+  chip.seed(0);
+  ASSERT_TRUE(chip.load_rom(std::string(CHIP8_ROM_DIR) + "/tetris.ch8"));
+  ExploreOptions options;
+  options.max_depth = 6;
+  options.segment_frames = 60;
+  options.threads = 1;
+  ExploreReport one = explore(chip, options);
+  options.threads = 4;
+  ExploreReport four = explore(chip, options);
+  ASSERT_GT(one.states, 10u);
+  ASSERT_EQ(one.states, four.states);
+  ASSERT_EQ(one.duplicates, four.duplicates);
+  ASSERT_EQ(one.screens, four.screens);
+  ASSERT_EQ(one.reached, four.reached);
+}
+
+TEST(ExplorerTest, HashSetGrows) {
+  HashSet set;
+  for (uint64_t i = 0; i < 5000; i++) {
+    ASSERT_TRUE(set.insert(i * 0x9e3779b97f4a7c15ull));
+  }
+  for (uint64_t i = 0; i < 5000; i++) {
+    ASSERT_FALSE(set.insert(i * 0x9e3779b97f4a7c15ull));
+  }
+  ASSERT_EQ(set.size(), 5000u);
+}
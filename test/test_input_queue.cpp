@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "../input-queue/input-queue.h"
+
+TEST(SPSCRingTest, TestPushPopWrapsAround) {
+  SPSCRing<int, 4> ring;
+  int value = 0;
+  ASSERT_FALSE(ring.pop(value));
+
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(ring.push(round * 10 + i));
+    }
+    ASSERT_FALSE(ring.push(99)); // full
+    ASSERT_EQ(ring.size(), 4u);
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(ring.pop(value));
+      ASSERT_EQ(value, round * 10 + i);
+    }
+    ASSERT_TRUE(ring.empty());
+  }
+}
+
+TEST(InputQueueTest, TestDrainAppliesInOrder) {
+  InputQueue input;
+  std::array<uint8_t, 16> keypad{};
+  input.push(0x1, true, 1);
+  input.push(0x2, true, 2);
+  input.push(0xf, true, 3);
+
+  ASSERT_EQ(input.drain(keypad), 3);
+  ASSERT_EQ(keypad[0x1], 1);
+  ASSERT_EQ(keypad[0x2], 1);
+  ASSERT_EQ(keypad[0xf], 1);
+  ASSERT_TRUE(input.empty());
+  ASSERT_EQ(input.drain(keypad), 0);
+}
+
+TEST(InputQueueTest, TestTapIsSeenByOneCycle) {
+  InputQueue input;
+  std::array<uint8_t, 16> keypad{};
+  // pressed and released before the emulation thread got around to draining
+  input.push(0xa, true, 1);
+  input.push(0x3, true, 2);
+  input.push(0xa, false, 3);
+
+  ASSERT_EQ(input.drain(keypad), 2);
+  ASSERT_EQ(keypad[0xa], 1);
+  ASSERT_EQ(keypad[0x3], 1);
+
+  // the release lands on the next cycle boundary
+  ASSERT_EQ(input.drain(keypad), 1);
+  ASSERT_EQ(keypad[0xa], 0);
+  ASSERT_EQ(keypad[0x3], 1);
+}
+
+TEST(InputQueueTest, TestIgnoresOutOfRangeKeys) {
+  InputQueue input;
+  std::array<uint8_t, 16> keypad{};
+  input.push(0x10, true, 1);
+  input.push(0x4, true, 2);
+  ASSERT_EQ(input.drain(keypad), 1);
+  ASSERT_EQ(keypad[0x4], 1);
+  ASSERT_TRUE(input.empty());
+}
+
+TEST(InputQueueTest, TestRecordsLatency) {
+  InputQueue input;
+  std::array<uint8_t, 16> keypad{};
+  uint64_t pushed = InputQueue::now_ns();
+  input.push(0x1, true, pushed);
+  input.push(0x2, true, pushed);
+  Histogram latency;
+  ASSERT_EQ(input.drain(keypad, &latency), 2);
+  ASSERT_EQ(latency.count(), 2u);
+  ASSERT_LE(latency.max(), InputQueue::now_ns() - pushed);
+}
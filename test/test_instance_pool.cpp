@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../instance-pool/instance-pool.h"
+
+namespace {
+const std::string PONG = std::string(CHIP8_ROM_DIR) + "/pong.ch8";
+const std::string TETRIS = std::string(CHIP8_ROM_DIR) + "/tetris.ch8";
+} // namespace
+
+TEST(InstancePoolTest, LoadsEachRomOnce) {
+  InstancePool pool;
+  int pong = pool.add_rom(PONG);
+  ASSERT_EQ(pong, 0);
+  ASSERT_EQ(pool.add_rom(TETRIS), 1);
+  ASSERT_EQ(pool.add_rom(PONG), pong);
+  ASSERT_EQ(pool.add_rom("no-such.ch8"), -1);
+  ASSERT_EQ(pool.rom_count(), 2u);
+
+  CHIP8 fresh;
+  ASSERT_TRUE(fresh.load_rom(PONG));
+  ASSERT_EQ(pool.snapshot(pong).state_digest(), fresh.state_digest());
+}
+
+TEST(InstancePoolTest, ResetReturnsToJustLoaded) {
+  InstancePool pool;
+  CHIP8 configured;
+  configured.seed(3);
+  configured.quirks = Quirks::cosmac_vip();
+  int rom = pool.add_rom(PONG, configured);
+  int slot = pool.acquire(rom);
+  CHIP8 &chip = pool.instance(slot);
+  ASSERT_TRUE(chip.quirks.shift_uses_vy);
+
+  chip.set_key(4, true);
+  chip.run_until(120);
+  uint64_t first = chip.state_digest();
+  ASSERT_NE(first, pool.snapshot(rom).state_digest());
+
+  pool.reset(slot);
+  ASSERT_EQ(chip.frame_number, 0u);
+  ASSERT_EQ(chip.state_digest(), pool.snapshot(rom).state_digest());
+  // the RNG is restored too, so the episode replays exactly
+  chip.set_key(4, true);
+  chip.run_until(120);
+  ASSERT_EQ(chip.state_digest(), first);
+}
+
+TEST(InstancePoolTest, ReusesReleasedSlots) {
+  InstancePool pool;
+  int pong = pool.add_rom(PONG);
+  int tetris = pool.add_rom(TETRIS);
+  int a = pool.acquire(pong);
+  int b = pool.acquire(pong);
+  ASSERT_NE(a, b);
+  ASSERT_EQ(pool.in_use(), 2u);
+  pool.instance(a).run_until(10);
+
+  pool.release(a);
+  pool.release(a); // twice is harmless
+  ASSERT_EQ(pool.in_use(), 1u);
+  int c = pool.acquire(tetris);
+  ASSERT_EQ(c, a);
+  ASSERT_EQ(pool.instance(c).state_digest(),
+            pool.snapshot(tetris).state_digest());
+}
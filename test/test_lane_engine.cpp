@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../lane-engine/lane-engine.h"
+
+namespace {
+// Runs the same machines through CHIP8::cycle() and through the lanes, each
+// lane with its own seed and keys, and compares every lane after each frame
+void differential(const std::vector<CHIP8> &machines, int frames) {
+  std::vector<CHIP8> scalar = machines;
+  LaneEngine lanes;
+  lanes.quirks = machines[0].quirks;
+  for (int lane = 0; lane < LANES; lane++) {
+    lanes.load(lane, scalar[lane]);
+  }
+
+  CHIP8 stored;
+  for (int frame = 0; frame < frames; frame++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      // hold a different key now and then, per lane
+      int key = (frame / 7 + lane * 3) % 16;
+      bool pressed = (frame + lane) % 5 == 0;
+      scalar[lane].keypad.fill(0);
+      scalar[lane].set_key(key, pressed);
+      for (auto &keys : lanes.keypad) {
+        keys[lane] = 0;
+      }
+      lanes.keypad[key][lane] = pressed;
+
+      scalar[lane].step(DEFAULT_CYCLES_PER_FRAME);
+      scalar[lane].tick_timers();
+    }
+    lanes.step(DEFAULT_CYCLES_PER_FRAME);
+    lanes.tick_timers();
+
+    for (int lane = 0; lane < LANES; lane++) {
+      lanes.store(lane, stored);
+      ASSERT_EQ(stored.state_digest(), scalar[lane].state_digest())
+          << "lane " << lane << " frame " << frame;
+      // the digest leaves out the RNG, so compare the next draw instead
+      FastRandom expected = scalar[lane].random;
+      ASSERT_EQ(stored.random.next_byte(), expected.next_byte());
+    }
+  }
+}
+
+std::vector<CHIP8> seeded(const std::string &rom) {
+  std::vector<CHIP8> machines(LANES);
+  for (int lane = 0; lane < LANES; lane++) {
+    EXPECT_TRUE(
+        machines[lane].load_rom(std::string(CHIP8_ROM_DIR) + "/" + rom));
+    machines[lane].seed(lane + 1);
+  }
+  return machines;
+}
+// Recurses until V0 reaches 40, well past the stack's depth, then returns once
+// too often and keeps returning from an empty stack
+std::vector<CHIP8> recursing() {
+  const uint8_t rom[] = {
+      0x70, 0x01, // 200: ADD V0, 1
+      0x30, 0x28, // 202: SE V0, 40
+      0x22, 0x00, // 204: CALL 200
+      0x00, 0xee, // 206: RET
+  };
+  std::vector<CHIP8> machines(LANES);
+  for (int lane = 0; lane < LANES; lane++) {
+    EXPECT_TRUE(machines[lane].load_rom(rom, sizeof(rom)));
+    // so the lanes reach each depth at different times
+    machines[lane].registers[0] = lane;
+  }
+  return machines;
+}
+} // namespace
+
+TEST(LaneEngineTest, MatchesScalarOnDeepCalls) {
+  differential(recursing(), 20);
+}
+
+TEST(LaneEngineTest, MatchesScalarFromAFullStack) {
+  std::vector<CHIP8> machines = recursing();
+  for (int lane = 0; lane < LANES; lane++) {
+    for (WORD level = 0; level < CALL_STACK_DEPTH; level++) {
+      machines[lane].stack.push_back(0x206 - 2 * (level % 2));
+    }
+  }
+  differential(machines, 20);
+}
+
+TEST(LaneEngineTest, MatchesScalarOnDemoRoms) {
+  for (const char *rom : {"IBM_logo.ch8", "test_opcode.ch8", "bc_test.ch8",
+                          "particles.ch8", "pong.ch8", "tetris.ch8",
+                          "trip8.ch8", "keypad_test.ch8"}) {
+    SCOPED_TRACE(rom);
+    differential(seeded(rom), 300);
+  }
+}
+
+TEST(LaneEngineTest, MatchesScalarWithVipQuirks) {
+  std::vector<CHIP8> machines = seeded("test_opcode.ch8");
+  for (CHIP8 &chip : machines) {
+    chip.quirks = Quirks::cosmac_vip();
+  }
+  differential(machines, 100);
+}
+
+TEST(LaneEngineTest, LanesInStepRunConverged) {
+  // ALU ops and a jump back: nothing to make the lanes diverge
+  const uint8_t rom[] = {
+      0x71, 0x03, // 200: ADD V1, 3
+      0x82, 0x14, // 202: ADD V2, V1
+      0x83, 0x26, // 204: SHR V3, V2
+      0x12, 0x00, // 206: JP 200
+  };
+  CHIP8 chip;
+  chip.load_rom(rom, sizeof(rom));
+  LaneEngine lanes;
+  for (int lane = 0; lane < LANES; lane++) {
+    lanes.load(lane, chip);
+  }
+  lanes.step(1000);
+  chip.step(1000);
+  ASSERT_EQ(lanes.converged_cycles, lanes.cycles);
+
+  CHIP8 stored;
+  lanes.store(LANES - 1, stored);
+  ASSERT_EQ(stored.state_digest(), chip.state_digest());
+}
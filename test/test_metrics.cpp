@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "../metrics/metrics.h"
+
+TEST(MetricsTest, BucketsAreContiguous) {
+  for (int i = 0; i + 1 < HISTOGRAM_BUCKETS; i++) {
+    uint64_t floor = Histogram::bucket_floor(i);
+    uint64_t next = Histogram::bucket_floor(i + 1);
+    ASSERT_LT(floor, next);
+    ASSERT_EQ(Histogram::bucket(floor), i);
+    ASSERT_EQ(Histogram::bucket(next - 1), i);
+  }
+  ASSERT_EQ(Histogram::bucket(UINT64_MAX), HISTOGRAM_BUCKETS - 1);
+}
+
+TEST(MetricsTest, PercentilesAreWithinASubBucket) {
+  Histogram histogram;
+  ASSERT_EQ(histogram.percentile(0.5), 0u);
+  for (uint64_t value = 1; value <= 100000; value++) {
+    histogram.record(value);
+  }
+  ASSERT_EQ(histogram.count(), 100000u);
+  ASSERT_EQ(histogram.max(), 100000u);
+  ASSERT_DOUBLE_EQ(histogram.mean(), 50000.5);
+  for (double q : {0.5, 0.9, 0.99}) {
+    double exact = q * 100000;
+    ASSERT_GE(histogram.percentile(q), exact);
+    ASSERT_LE(histogram.percentile(q), exact * (1 + 1.0 / 16));
+  }
+  ASSERT_EQ(histogram.percentile(1), 100000u);
+}
+
+TEST(MetricsTest, ExportsJson) {
+  Metrics metrics;
+  metrics.instructions.add(700);
+  metrics.frames.add(1);
+  metrics.frame_ns.record(2000);
+  std::ostringstream out;
+  write_metrics_json(metrics, out);
+  std::string json = out.str();
+  ASSERT_EQ(json.front(), '{');
+  ASSERT_EQ(json.substr(json.size() - 2), "}\n");
+  ASSERT_NE(json.find("\"instructions\": 700"), std::string::npos);
+  ASSERT_NE(json.find("\"frame_ns\": {\"count\": 1"), std::string::npos);
+  ASSERT_NE(json.find("\"input_latency_ns\": {\"count\": 0"),
+            std::string::npos);
+}
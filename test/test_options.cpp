@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include "../options/options.h"
+
+TEST(OptionsTest, TestPositionalOnly) {
+  const char *argv[] = {"main", "10", "2", "rom.ch8"};
+  Options options;
+  ASSERT_TRUE(parse_options(4, const_cast<char **>(argv), options));
+  ASSERT_EQ(options.video_scale, 10);
+  ASSERT_EQ(options.cycle_delay, 2);
+  ASSERT_EQ(options.rom, "rom.ch8");
+  ASSERT_FALSE(options.turbo);
+  ASSERT_EQ(options.speed, 1.0);
+}
+
+TEST(OptionsTest, TestTurboAndSpeed) {
+  const char *argv[] = {"main",        "--turbo", "--frameskip", "4", "8",
+                        "1",           "rom.ch8", "--speed",     "0.5"};
+  Options options;
+  ASSERT_TRUE(parse_options(9, const_cast<char **>(argv), options));
+  ASSERT_TRUE(options.turbo);
+  ASSERT_EQ(options.turbo_frameskip, 4);
+  ASSERT_EQ(options.speed, 0.5);
+  ASSERT_EQ(options.video_scale, 8);
+  ASSERT_EQ(options.rom, "rom.ch8");
+}
+
+TEST(OptionsTest, TestRejectsBadArguments) {
+  Options options;
+  const char *missing[] = {"main", "10", "rom.ch8"};
+  ASSERT_FALSE(parse_options(3, const_cast<char **>(missing), options));
+  const char *unknown[] = {"main", "--fast", "10", "2", "rom.ch8"};
+  ASSERT_FALSE(parse_options(5, const_cast<char **>(unknown), options));
+  const char *zero_speed[] = {"main", "--speed", "0", "10", "2", "rom.ch8"};
+  ASSERT_FALSE(parse_options(6, const_cast<char **>(zero_speed), options));
+}
+
+TEST(OptionsTest, TestPlaylist) {
+  const char *argv[] = {"main",  "10",    "2",
+                        "a.ch8", "b.ch8", "--playlist-seconds",
+                        "30",    "c.ch8"};
+  Options options;
+  ASSERT_TRUE(parse_options(8, const_cast<char **>(argv), options));
+  ASSERT_EQ(options.rom, "a.ch8");
+  ASSERT_EQ(options.playlist,
+            std::vector<std::string>({"a.ch8", "b.ch8", "c.ch8"}));
+  ASSERT_EQ(options.playlist_seconds, 30);
+}
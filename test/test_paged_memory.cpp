@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../chip/chip8.h"
+
+TEST(PagedMemoryTest, CopiesShareUntilWritten) {
+  PagedMemory original;
+  original[0x200] = 0x12;
+  original[0x2ff] = 0x34;
+  ASSERT_EQ(original.private_pages(), 1u);
+
+  PagedMemory copy = original;
+  ASSERT_EQ(copy.private_pages(), 0u);
+  ASSERT_TRUE(copy.shares_page(original, 2));
+  ASSERT_EQ(copy[0x200], 0x12);
+
+  copy[0x201] = 0x56;
+  ASSERT_FALSE(copy.shares_page(original, 2));
+  ASSERT_EQ(copy[0x200], 0x12);
+  ASSERT_EQ(copy[0x201], 0x56);
+  ASSERT_EQ(original[0x201], 0);
+  // the other pages are still shared
+  ASSERT_TRUE(copy.shares_page(original, 3));
+  ASSERT_EQ(copy.private_pages(), 1u);
+  ASSERT_EQ(original.private_pages(), 1u);
+}
+
+TEST(PagedMemoryTest, ReadingDoesNotCopy) {
+  PagedMemory original;
+  original[0x300] = 7;
+  PagedMemory copy = original;
+  // a non-const read goes through Reference
+  uint8_t value = copy[0x300];
+  ASSERT_EQ(value, 7);
+  ASSERT_TRUE(copy.shares_page(original, 3));
+}
+
+TEST(PagedMemoryTest, FillAndAssignment) {
+  PagedMemory memory;
+  memory.fill(0xaa);
+  ASSERT_EQ(memory.private_pages(), MEMORY_PAGES);
+  ASSERT_EQ(memory[0xfff], 0xaa);
+
+  PagedMemory other;
+  other = memory;
+  PagedMemory &same = other;
+  other = same;
+  ASSERT_EQ(other[0x123], 0xaa);
+  memory.fill(0);
+  ASSERT_EQ(memory.private_pages(), 0u);
+  ASSERT_EQ(memory[0x123], 0);
+  ASSERT_EQ(other[0x123], 0xaa);
+}
+
+TEST(PagedMemoryTest, ForkedMachinesStayIndependent) {
+  // LD V0, 9; LD I, 300; LD [I], V0; JP 206
+  const uint8_t rom[] = {0x60, 0x09, 0xa3, 0x00, 0xf0, 0x55, 0x12, 0x06};
+  CHIP8 chip;
+  chip.load_rom(rom, sizeof(rom));
+  CHIP8 fork = chip;
+  uint64_t before = chip.state_digest();
+  fork.step(3);
+  ASSERT_EQ(fork.memory[0x300], 9);
+  ASSERT_EQ(chip.memory[0x300], 0);
+  ASSERT_EQ(chip.state_digest(), before);
+
+  std::vector<uint8_t> state;
+  fork.save_state(state);
+  ASSERT_TRUE(chip.restore_state(state.data(), state.size()));
+  ASSERT_EQ(chip.state_digest(), fork.state_digest());
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <random>
+
+#include "../filter/phosphor.h"
+
+TEST(PhosphorTest, TestSimdMatchesScalar) {
+  std::mt19937 rng(1234);
+  std::vector<uint8_t> intensity(1000), lit(1000);
+  for (std::size_t i = 0; i < intensity.size(); i++) {
+    intensity[i] = rng() & 0xff;
+    lit[i] = rng() & 1 ? 0xff : 0x00;
+  }
+  std::vector<uint8_t> reference = intensity;
+
+  for (int decay : {0, 1, 128, 200, 255}) {
+    phosphor_step(intensity.data(), lit.data(), intensity.size(), decay);
+    phosphor_step_scalar(reference.data(), lit.data(), reference.size(),
+                         decay);
+    ASSERT_EQ(intensity, reference);
+  }
+}
+
+TEST(PhosphorTest, TestPixelsFadeOut) {
+  PhosphorFilter filter(2, 0.5, false, false);
+  ASSERT_EQ(filter.output_width(), 128);
+  ASSERT_EQ(filter.output_height(), 64);
+  std::vector<uint32_t> out(128 * 64);
+  const int pitch = 128 * sizeof(uint32_t);
+
+  Frame frame{};
+  frame[0] = 1ull << 63; // top-left pixel
+  filter.apply(frame, out.data(), pitch);
+  ASSERT_EQ(out[0], 0xffffffffu);
+  ASSERT_EQ(out[1], 0xffffffffu);
+  ASSERT_EQ(out[128 + 1], 0xffffffffu);
+  ASSERT_EQ(out[2], 0x000000ffu);
+
+  // switched off: brightness halves each frame instead of going black
+  filter.apply(Frame{}, out.data(), pitch);
+  ASSERT_EQ(out[0], 0x7f7f7fffu);
+  filter.apply(Frame{}, out.data(), pitch);
+  ASSERT_EQ(out[0], 0x3f3f3fffu);
+}
+
+TEST(PhosphorTest, TestScanlinesDimLastLine) {
+  PhosphorFilter filter(3, 0, false, true);
+  std::vector<uint32_t> out(192 * 96);
+  Frame frame{};
+  frame[0] = ~0ull;
+  filter.apply(frame, out.data(), 192 * sizeof(uint32_t));
+  ASSERT_EQ(out[0 * 192], 0xffffffffu);
+  ASSERT_EQ(out[1 * 192], 0xffffffffu);
+  ASSERT_EQ(out[2 * 192], 0x9f9f9fffu);
+  ASSERT_EQ(out[3 * 192], 0x000000ffu);
+}
+
+TEST(PhosphorTest, TestScale2xSmoothsDiagonals) {
+  // a diagonal step:  X.
+  //                   .X
+  Frame frame{};
+  frame[10] = 1ull << 63 >> 10;
+  frame[11] = 1ull << 63 >> 11;
+  std::vector<uint64_t> out(HEIGHT * 2 * 2);
+  scale2x_frame(frame, out.data());
+
+  auto pixel = [&](int x, int y) {
+    return (out[y * 2 + x / 64] >> (63 - x % 64)) & 1;
+  };
+  // the corners facing each other are filled in
+  ASSERT_EQ(pixel(21, 21), 1u);
+  ASSERT_EQ(pixel(20, 21), 1u);
+  ASSERT_EQ(pixel(21, 20), 1u);
+  ASSERT_EQ(pixel(22, 22), 1u);
+  ASSERT_EQ(pixel(23, 22), 1u);
+  ASSERT_EQ(pixel(22, 23), 1u);
+  // and the outer ones aren't
+  ASSERT_EQ(pixel(20, 20), 1u);
+  ASSERT_EQ(pixel(23, 23), 1u);
+  ASSERT_EQ(pixel(23, 20), 0u);
+  ASSERT_EQ(pixel(20, 23), 0u);
+
+  // lone pixels and straight edges are unchanged, across the word boundary
+  Frame line{};
+  line[5] = 0x00000001ffffffffull;
+  scale2x_frame(line, out.data());
+  for (int x = 0; x < 128; x++) {
+    uint64_t expected = x >= 62 ? 1 : 0;
+    ASSERT_EQ(pixel(x, 10), expected);
+    ASSERT_EQ(pixel(x, 11), expected);
+  }
+}
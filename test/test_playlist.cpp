@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include "../playlist/playlist.h"
+
+namespace {
+const std::string ROMS = CHIP8_ROM_DIR;
+}
+
+TEST(PlaylistTest, SelectsPreloadedSnapshots) {
+  CHIP8 configured;
+  configured.quirks = Quirks::cosmac_vip();
+  Playlist playlist({ROMS + "/pong.ch8", ROMS + "/tetris.ch8"}, configured);
+  const CHIP8 *pong = playlist.select(0);
+  ASSERT_NE(pong, nullptr);
+  CHIP8 expected = configured;
+  ASSERT_TRUE(expected.load_rom(ROMS + "/pong.ch8"));
+  ASSERT_EQ(pong->state_hash(), expected.state_hash());
+  ASSERT_TRUE(pong->quirks.logic_resets_vf);
+
+  const CHIP8 *tetris = playlist.next();
+  ASSERT_NE(tetris, nullptr);
+  ASSERT_EQ(playlist.position(), 1u);
+  ASSERT_NE(tetris->state_hash(), pong->state_hash());
+  // the same snapshot again, not a reload
+  ASSERT_EQ(playlist.next(), pong);
+  ASSERT_EQ(playlist.previous(), tetris);
+}
+
+TEST(PlaylistTest, SkipsRomsThatDontLoad) {
+  Playlist playlist(
+      {ROMS + "/pong.ch8", ROMS + "/missing.ch8", ROMS + "/tetris.ch8"});
+  ASSERT_EQ(playlist.select(1), nullptr);
+  ASSERT_NE(playlist.select(0), nullptr);
+  ASSERT_NE(playlist.next(), nullptr);
+  ASSERT_EQ(playlist.position(), 2u);
+  ASSERT_NE(playlist.previous(), nullptr);
+  ASSERT_EQ(playlist.position(), 0u);
+  ASSERT_EQ(playlist.path(2), ROMS + "/tetris.ch8");
+}
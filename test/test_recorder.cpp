@@ -0,0 +1,221 @@
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <sstream>
+
+#include "../recorder/recorder.h"
+
+namespace {
+
+Frame make_frame(int seed) {
+  Frame frame{};
+  frame[seed % HEIGHT] = 0xf0f0f0f0f0f0f0f0ull >> (seed % 8);
+  frame[(seed * 7) % HEIGHT] |= 1;
+  return frame;
+}
+
+struct GifImage {
+  int delay, left, top, width, height;
+  std::vector<uint8_t> pixels;
+};
+
+int get_word(const std::string &s, std::size_t at) {
+  return (uint8_t)s[at] | ((uint8_t)s[at + 1] << 8);
+}
+
+// Just enough of a GIF decoder to read back what GifEncoder writes
+std::vector<GifImage> decode_gif(const std::string &s, int &width,
+                                 int &height) {
+  std::vector<GifImage> images;
+  EXPECT_EQ(s.substr(0, 6), "GIF89a");
+  width = get_word(s, 6);
+  height = get_word(s, 8);
+  std::size_t at = 13 + 6; // header + 2 color global palette
+  int delay = 0;
+  while (at < s.size() && s[at] != 0x3b) {
+    if (s[at] == 0x21) {
+      if ((uint8_t)s[at + 1] == 0xf9) {
+        delay = get_word(s, at + 4);
+      }
+      at += 2;
+      while (s[at]) {
+        at += (uint8_t)s[at] + 1;
+      }
+      at++;
+      continue;
+    }
+    EXPECT_EQ(s[at], 0x2c);
+    GifImage image{delay, get_word(s, at + 1), get_word(s, at + 3),
+                   get_word(s, at + 5), get_word(s, at + 7), {}};
+    at += 10;
+    int min_code_size = s[at++];
+    std::string data;
+    while (s[at]) {
+      data += s.substr(at + 1, (uint8_t)s[at]);
+      at += (uint8_t)s[at] + 1;
+    }
+    at++;
+
+    const int clear = 1 << min_code_size;
+    std::vector<std::vector<uint8_t>> dict;
+    int width_bits = min_code_size + 1;
+    std::size_t bit = 0;
+    std::vector<uint8_t> previous;
+    while (true) {
+      int code = 0;
+      for (int i = 0; i < width_bits; i++, bit++) {
+        code |= (((uint8_t)data[bit / 8] >> (bit % 8)) & 1) << i;
+      }
+      if (code == clear) {
+        dict.clear();
+        for (int i = 0; i < clear + 2; i++) {
+          dict.push_back({(uint8_t)i});
+        }
+        width_bits = min_code_size + 1;
+        previous.clear();
+        continue;
+      }
+      if (code == clear + 1) {
+        break;
+      }
+      std::vector<uint8_t> entry;
+      if (code < (int)dict.size()) {
+        entry = dict[code];
+      } else {
+        entry = previous;
+        entry.push_back(previous[0]);
+      }
+      image.pixels.insert(image.pixels.end(), entry.begin(), entry.end());
+      if (!previous.empty()) {
+        previous.push_back(entry[0]);
+        dict.push_back(previous);
+        if ((int)dict.size() == (1 << width_bits) && width_bits < 12) {
+          width_bits++;
+        }
+      }
+      previous = entry;
+    }
+    images.push_back(image);
+  }
+  return images;
+}
+
+} // namespace
+
+TEST(RecorderTest, TestRawFrames) {
+  std::ostringstream out;
+  RawEncoder encoder(out);
+  Frame frame{};
+  frame[0] = 0x8000000000000001ull;
+  frame[31] = 0xff00000000000000ull;
+  encoder.encode(frame);
+  encoder.encode(Frame{});
+  encoder.finish();
+
+  std::string bytes = out.str();
+  ASSERT_EQ(bytes.size(), 512u);
+  ASSERT_EQ((uint8_t)bytes[0], 0x80);
+  ASSERT_EQ((uint8_t)bytes[7], 0x01);
+  ASSERT_EQ((uint8_t)bytes[31 * 8], 0xff);
+  ASSERT_EQ((uint8_t)bytes[256], 0);
+}
+
+TEST(RecorderTest, TestY4MFrames) {
+  std::ostringstream out;
+  Y4MEncoder encoder(out, 2);
+  Frame frame{};
+  frame[1] = 1ull << 63; // pixel (0, 1)
+  encoder.encode(frame);
+  encoder.encode(Frame{});
+  encoder.finish();
+
+  std::string header = "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 Cmono\n";
+  std::string bytes = out.str();
+  const std::size_t frame_size = 6 + 128 * 64;
+  ASSERT_EQ(bytes.size(), header.size() + 2 * frame_size);
+  ASSERT_EQ(bytes.substr(0, header.size()), header);
+
+  const char *image = bytes.data() + header.size() + 6;
+  ASSERT_EQ((uint8_t)image[2 * 128], 255); // (0, 1) scaled to (0..1, 2..3)
+  ASSERT_EQ((uint8_t)image[3 * 128 + 1], 255);
+  ASSERT_EQ((uint8_t)image[3 * 128 + 2], 0);
+  ASSERT_EQ((uint8_t)image[0], 0);
+  // cleared again in the second frame
+  ASSERT_EQ((uint8_t)image[frame_size + 2 * 128], 0);
+}
+
+TEST(RecorderTest, TestGifDeltaFrames) {
+  std::ostringstream out;
+  GifEncoder encoder(out, 3);
+  Frame first = make_frame(3);
+  Frame second = first;
+  second[10] ^= 0x00000ff000000000ull;
+
+  for (int i = 0; i < 6; i++) {
+    encoder.encode(first); // repeats merge into one 10 cs frame
+  }
+  encoder.encode(second);
+  encoder.finish();
+
+  int width, height;
+  std::vector<GifImage> images = decode_gif(out.str(), width, height);
+  ASSERT_EQ(width, 64 * 3);
+  ASSERT_EQ(height, 32 * 3);
+  ASSERT_EQ(images.size(), 2u);
+
+  const GifImage &full = images[0];
+  ASSERT_EQ(full.delay, 10);
+  ASSERT_EQ(full.width, 64 * 3);
+  ASSERT_EQ(full.height, 32 * 3);
+  ASSERT_EQ(full.pixels.size(), (std::size_t)full.width * full.height);
+  for (int y = 0; y < full.height; y++) {
+    for (int x = 0; x < full.width; x++) {
+      int lit = (first[y / 3] >> (63 - x / 3)) & 1;
+      ASSERT_EQ(full.pixels[y * full.width + x], lit);
+    }
+  }
+
+  // only the changed 8x1 pixel run is sent
+  const GifImage &delta = images[1];
+  ASSERT_EQ(delta.left, 20 * 3);
+  ASSERT_EQ(delta.top, 10 * 3);
+  ASSERT_EQ(delta.width, 8 * 3);
+  ASSERT_EQ(delta.height, 1 * 3);
+  for (int x = 0; x < delta.width; x++) {
+    int lit = (second[10] >> (63 - (20 + x / 3))) & 1;
+    ASSERT_EQ(delta.pixels[x], lit);
+  }
+}
+
+TEST(RecorderTest, TestRecorderCountsDroppedFrames) {
+  const std::string filename = testing::TempDir() + "recorder_test.raw";
+  const int submitted = 5000;
+  uint64_t dropped;
+  {
+    Recorder recorder(filename);
+    ASSERT_TRUE(recorder.ok());
+    for (int i = 0; i < submitted; i++) {
+      recorder.submit(make_frame(i));
+    }
+    recorder.close();
+    dropped = recorder.dropped_frames();
+  }
+
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  std::size_t written = (std::size_t)file.tellg() / 256;
+  ASSERT_EQ(written + dropped, (std::size_t)submitted);
+}
+
+TEST(RecorderTest, TestRejectsUnknownFormat) {
+  const std::string filename = testing::TempDir() + "recorder_test.mp4";
+  std::ofstream(filename) << "keep me";
+  {
+    Recorder recorder(filename);
+    ASSERT_FALSE(recorder.ok());
+  }
+  // a mistyped format leaves an existing file alone
+  std::ifstream file(filename);
+  std::string contents((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+  ASSERT_EQ(contents, "keep me");
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../regression/golden.h"
+
+namespace {
+const std::string GOLDEN_DIR = std::string(CHIP8_SOURCE_DIR) + "/test/golden";
+
+std::vector<RegressionCase> load_cases() {
+  std::vector<RegressionCase> cases;
+  std::string error;
+  EXPECT_TRUE(load_suite(GOLDEN_DIR + "/suite.txt", cases, error)) << error;
+  return cases;
+}
+} // namespace
+
+TEST(RegressionTest, DemoRomsMatchTheirGoldenFrames) {
+  std::vector<Checkpoint> golden;
+  std::string error;
+  ASSERT_TRUE(load_golden(GOLDEN_DIR + "/golden.txt", golden, error)) << error;
+  std::vector<Checkpoint> actual = run_suite(load_cases(), CHIP8_ROM_DIR);
+  ASSERT_FALSE(golden.empty());
+  for (const Mismatch &mismatch :
+       compare(golden, actual, ::testing::TempDir())) {
+    ADD_FAILURE() << mismatch.rom << " frame " << mismatch.frame << ": "
+                  << mismatch.reason;
+  }
+}
+
+TEST(RegressionTest, ThreadCountDoesNotChangeResults) {
+  std::vector<RegressionCase> cases = load_cases();
+  std::vector<Checkpoint> serial = run_suite(cases, CHIP8_ROM_DIR, 1);
+  std::vector<Checkpoint> parallel = run_suite(cases, CHIP8_ROM_DIR, 4);
+  ASSERT_EQ(serial.size(), parallel.size());
+  ASSERT_TRUE(compare(serial, parallel).empty());
+}
+
+TEST(RegressionTest, InputIsScripted) {
+  RegressionCase still = {"pong.ch8", {240}, {}};
+  RegressionCase moving = {"pong.ch8", {240}, {{150, 4, true}}};
+  ASSERT_NE(run_case(still, CHIP8_ROM_DIR)[0].hash,
+            run_case(moving, CHIP8_ROM_DIR)[0].hash);
+  ASSERT_TRUE(run_case({"missing.ch8", {1}, {}}, CHIP8_ROM_DIR).empty());
+}
+
+TEST(RegressionTest, DiffImageColorsEachSide) {
+  Frame expected{}, actual{};
+  expected[0] = 3ull << 62; // (0, 0) and (1, 0)
+  actual[0] = 5ull << 61;   // (0, 0) and (2, 0)
+  std::string path = ::testing::TempDir() + "/diff.ppm";
+  ASSERT_TRUE(write_diff_image(path, expected, actual, 1));
+
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  int width, height, max;
+  in >> magic >> width >> height >> max;
+  in.get();
+  ASSERT_EQ(magic, "P6");
+  ASSERT_EQ(width, WIDTH);
+  std::vector<char> pixels(3 * 4);
+  in.read(pixels.data(), pixels.size());
+  const std::vector<char> want = {'\xff', '\xff', '\xff', '\xff', 0, 0,
+                                  0,      '\xff', 0,      0,      0, 0};
+  ASSERT_EQ(pixels, want);
+}
+
+TEST(RegressionTest, SuiteErrorsNameTheLine) {
+  std::string path = ::testing::TempDir() + "/suite.txt";
+  std::ofstream(path) << "# comment\npong.ch8 10 20 5:+1\npong.ch8 10 5:*1\n";
+  std::vector<RegressionCase> cases;
+  std::string error;
+  ASSERT_FALSE(load_suite(path, cases, error));
+  ASSERT_NE(error.find(":3: bad input 5:*1"), std::string::npos) << error;
+  ASSERT_EQ(cases.size(), 1u);
+  ASSERT_EQ(cases[0].checkpoints, (std::vector<uint64_t>{10, 20}));
+}
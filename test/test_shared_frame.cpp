@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "../shared-memory/shared-frame.h"
+
+namespace {
+std::string region_name(const char *test) {
+  return "/chip8-test-" + std::string(test) + "-" + std::to_string(getpid());
+}
+} // namespace
+
+TEST(SharedFrameTest, ReaderSeesPublishedState) {
+  std::string name = region_name("state");
+  SharedFramePublisher publisher(name);
+  ASSERT_TRUE(publisher.ok());
+  // a second mapping of the same object, as another process would have
+  SharedFrameReader reader(name);
+  ASSERT_TRUE(reader.ok());
+
+  SharedSnapshot snapshot;
+  ASSERT_FALSE(reader.read(snapshot));
+
+  CHIP8 chip = CHIP8();
+  chip.screen[0] = 0x8000000000000001ull;
+  chip.screen[HEIGHT - 1] = 0xf0;
+  chip.registers[0x3] = 0x33;
+  chip.registers[0xf] = 0x01;
+  chip.address_i = 0x123;
+  chip.program_counter = 0x456;
+  chip.delay_timer = 7;
+  chip.sound_timer = 9;
+  chip.frame_number = 42;
+  publisher.publish(chip);
+
+  ASSERT_TRUE(reader.read(snapshot));
+  ASSERT_EQ(snapshot.screen, chip.screen);
+  ASSERT_EQ(snapshot.registers, chip.registers);
+  ASSERT_EQ(snapshot.address_i, 0x123);
+  ASSERT_EQ(snapshot.program_counter, 0x456);
+  ASSERT_EQ(snapshot.delay_timer, 7);
+  ASSERT_EQ(snapshot.sound_timer, 9);
+  ASSERT_EQ(snapshot.frame_number, 42u);
+  // nothing new since
+  ASSERT_FALSE(reader.read(snapshot));
+
+  reader.set_key(0xa, true);
+  reader.set_key(0x1, true);
+  reader.set_key(0x1, false);
+  publisher.apply_keys(chip);
+  for (int key = 0; key < 16; key++) {
+    ASSERT_EQ(chip.keypad[key], key == 0xa ? 1 : 0);
+  }
+}
+
+TEST(SharedFrameTest, MissingRegionIsNotOk) {
+  SharedFrameReader reader(region_name("missing"));
+  ASSERT_FALSE(reader.ok());
+}
+
+TEST(SharedFrameTest, ConcurrentReadsAreNeverTorn) {
+  std::string name = region_name("torn");
+  SharedFramePublisher publisher(name);
+  SharedFrameReader reader(name);
+  ASSERT_TRUE(reader.ok());
+
+  const uint64_t frames = 20000;
+  // stand-in consumer: every row and V0 carry the frame number, so a
+  // snapshot mixing two frames shows up as a mismatch
+  std::thread consumer([&] {
+    SharedSnapshot snapshot;
+    uint64_t last = 0;
+    while (last < frames) {
+      if (!reader.read(snapshot)) {
+        continue;
+      }
+      for (int y = 0; y < HEIGHT; y++) {
+        ASSERT_EQ(snapshot.screen[y], snapshot.frame_number);
+      }
+      ASSERT_EQ(snapshot.registers[0], BYTE(snapshot.frame_number));
+      ASSERT_GT(snapshot.frame_number, last);
+      last = snapshot.frame_number;
+    }
+  });
+
+  CHIP8 chip = CHIP8();
+  for (uint64_t frame = 1; frame <= frames; frame++) {
+    chip.frame_number = frame;
+    chip.screen.fill(frame);
+    chip.registers[0] = frame;
+    publisher.publish(chip);
+  }
+  consumer.join();
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "../stream-server/stream-server.h"
+
+namespace {
+// Draws digit V0 at (V0, V0) every loop, moving on to the next digit while
+// key 1 is held
+const std::vector<uint8_t> rom = {
+    0x61, 0x01, // 200: LD V1, 1
+    0xf0, 0x29, // 202: LD F, V0
+    0xd0, 0x05, // 204: DRW V0, V0, 5
+    0xe1, 0xa1, // 206: SKNP V1
+    0x70, 0x01, // 208: ADD V0, 1
+    0x12, 0x02, // 20A: JP 202
+};
+
+// A server and a client joined over a Unix socket, driven from one thread:
+// the kernel buffers each side while the other isn't looking
+struct Session {
+  std::string path;
+  StreamServer server;
+  StreamClient client;
+
+  explicit Session(int instances)
+      : path("/tmp/chip8-stream-" + std::to_string(getpid())),
+        server(rom, instances, 4) {}
+
+  bool open() {
+    if (!server.listen_unix(path) || !client.connect_unix(path)) {
+      return false;
+    }
+    server.service(100);
+    return server.connection_count() == 1;
+  }
+
+  // Lets the server see what the client sent
+  void deliver() { server.service(100); }
+
+  uint8_t receive(uint16_t &instance) {
+    std::vector<uint8_t> state;
+    return client.receive(instance, state);
+  }
+};
+} // namespace
+
+TEST(StreamServerTest, ClientTracksEveryInstance) {
+  Session session(3);
+  ASSERT_TRUE(session.open());
+  for (uint16_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(session.client.subscribe(i));
+  }
+  session.deliver();
+  session.server.instance(1).set_key(1, true);
+
+  for (int frame = 1; frame <= 20; frame++) {
+    session.server.step();
+    for (int i = 0; i < 3; i++) {
+      uint16_t instance;
+      ASSERT_EQ(session.receive(instance), MSG_FRAME);
+      ASSERT_EQ(session.client.displays[instance],
+                session.server.instance(instance).frame_view());
+      ASSERT_EQ(session.client.frame_numbers[instance], uint64_t(frame));
+      // ack some frames and not others, so deltas build up across frames
+      if ((frame + instance) % 3 == 0) {
+        session.client.ack(instance);
+      }
+    }
+    session.deliver();
+  }
+  // key 1 only held on instance 1, so only it moved on
+  ASSERT_EQ(session.server.instance(0).registers[0], 0);
+  ASSERT_GT(session.server.instance(1).registers[0], 0);
+}
+
+TEST(StreamServerTest, KeysReachTheInstance) {
+  Session session(2);
+  ASSERT_TRUE(session.open());
+  session.client.set_key(1, 1, true);
+  session.deliver();
+  ASSERT_EQ(session.server.instance(1).keypad[1], 1);
+  ASSERT_EQ(session.server.instance(0).keypad[1], 0);
+  session.client.set_key(1, 1, false);
+  session.deliver();
+  ASSERT_EQ(session.server.instance(1).keypad[1], 0);
+}
+
+TEST(StreamServerTest, SnapshotAndRestore) {
+  Session session(1);
+  ASSERT_TRUE(session.open());
+  session.client.subscribe(0);
+  session.client.set_key(0, 1, true);
+  session.deliver();
+  for (int i = 0; i < 5; i++) {
+    session.server.step();
+  }
+
+  std::vector<uint8_t> state;
+  uint16_t instance;
+  session.client.request_snapshot(0);
+  session.deliver();
+  while (session.client.receive(instance, state) != MSG_STATE) {
+  }
+  uint64_t digest = session.server.instance(0).state_digest();
+
+  for (int i = 0; i < 5; i++) {
+    session.server.step();
+  }
+  ASSERT_NE(session.server.instance(0).state_digest(), digest);
+  session.client.restore(0, state);
+  session.deliver();
+  ASSERT_EQ(session.server.instance(0).state_digest(), digest);
+
+  // a bad blob drops the connection and leaves the instance alone
+  state.pop_back();
+  session.client.restore(0, state);
+  session.deliver();
+  ASSERT_EQ(session.server.connection_count(), 0u);
+  ASSERT_EQ(session.server.instance(0).state_digest(), digest);
+}
+
+TEST(StreamServerTest, ServesOverLoopbackTcp) {
+  StreamServer server(rom, 1, 4);
+  ASSERT_TRUE(server.listen_tcp(0));
+  ASSERT_NE(server.tcp_port(), 0);
+
+  std::thread thread([&] { server.run(); });
+  StreamClient client;
+  ASSERT_TRUE(client.connect_tcp(server.tcp_port()));
+  client.subscribe(0);
+  client.set_key(0, 1, true);
+
+  uint16_t instance;
+  std::vector<uint8_t> state;
+  int frames = 0;
+  while (frames < 10 && client.receive(instance, state) == MSG_FRAME) {
+    client.ack(instance);
+    frames++;
+  }
+  server.stop();
+  thread.join();
+  ASSERT_EQ(frames, 10);
+  // the last digit drawn is on the client's copy of the display
+  ASSERT_NE(client.displays[0], Frame{});
+}
+
+TEST(StreamServerTest, StalledClientDoesntBlockOthers) {
+  const int instances = 64;
+  Session session(instances);
+  ASSERT_TRUE(session.open());
+  // never reads, and without ACKs every frame carries every row
+  for (uint16_t i = 0; i < instances; i++) {
+    ASSERT_TRUE(session.client.subscribe(i));
+  }
+  StreamClient reader;
+  ASSERT_TRUE(reader.connect_unix(session.path));
+  session.deliver();
+  ASSERT_TRUE(reader.subscribe(0));
+  session.deliver();
+  ASSERT_EQ(session.server.connection_count(), 2u);
+
+  // ~18 KB a frame to the stalled client: far more than its socket holds
+  uint16_t instance;
+  std::vector<uint8_t> state;
+  for (int frame = 1; frame <= 200; frame++) {
+    session.server.step();
+    session.server.service(0);
+    ASSERT_EQ(reader.receive(instance, state), MSG_FRAME);
+    ASSERT_EQ(reader.frame_numbers[0], uint64_t(frame));
+  }
+  ASSERT_EQ(session.server.connection_count(), 2u);
+
+  // what did reach the stalled client, old as it is, is whole messages
+  std::map<uint16_t, uint64_t> last;
+  for (int i = 0; i < 3 * instances; i++) {
+    ASSERT_EQ(session.receive(instance), MSG_FRAME);
+    ASSERT_LT(instance, instances);
+    ASSERT_GT(session.client.frame_numbers[instance], last[instance]);
+    last[instance] = session.client.frame_numbers[instance];
+  }
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "../terminal/raw-terminal.h"
+#include "../terminal/terminal-renderer.h"
+
+namespace {
+/**
+ * Just enough of a terminal to play renderer output back: cursor
+ * positioning, cursor forward, clear screen and UTF-8 glyphs, one column
+ * each. Anything else fails the test.
+ */
+class Screen {
+public:
+  std::vector<std::string> cells =
+      std::vector<std::string>(TERMINAL_ROWS * TERMINAL_COLUMNS, " ");
+  int row = 0;
+  int column = 0;
+
+  void play(const std::string &out) {
+    for (std::size_t i = 0; i < out.size();) {
+      if (out[i] != '\x1b') {
+        std::size_t length = (out[i] & 0x80) ? 3 : 1;
+        ASSERT_LT(row * TERMINAL_COLUMNS + column, int(cells.size()));
+        cells[row * TERMINAL_COLUMNS + column] = out.substr(i, length);
+        column++;
+        i += length;
+        continue;
+      }
+      ASSERT_EQ(out[i + 1], '[');
+      std::size_t end = out.find_first_of("CHJlh", i + 2);
+      ASSERT_NE(end, std::string::npos);
+      std::string arguments = out.substr(i + 2, end - i - 2);
+      if (out[end] == 'C') {
+        column += std::stoi(arguments);
+      } else if (out[end] == 'H') {
+        row = std::stoi(arguments) - 1;
+        column = std::stoi(arguments.substr(arguments.find(';') + 1)) - 1;
+      } else if (out[end] == 'J') {
+        cells.assign(cells.size(), " ");
+      }
+      i = end + 1;
+    }
+  }
+
+  // What cell (row, column) should show for screen
+  static std::string expected(const Frame &screen, int row, int column) {
+    int shift = WIDTH - 1 - column;
+    int glyph = (screen[2 * row] >> shift & 1) |
+                (screen[2 * row + 1] >> shift & 1) << 1;
+    const char *glyphs[] = {" ", "\xe2\x96\x80", "\xe2\x96\x84",
+                            "\xe2\x96\x88"};
+    return glyphs[glyph];
+  }
+
+  void expect(const Frame &screen) {
+    for (int r = 0; r < TERMINAL_ROWS; r++) {
+      for (int c = 0; c < TERMINAL_COLUMNS; c++) {
+        ASSERT_EQ(cells[r * TERMINAL_COLUMNS + c], expected(screen, r, c))
+            << r << "," << c;
+      }
+    }
+  }
+};
+} // namespace
+
+TEST(TerminalRendererTest, PlaysBackToTheFrame) {
+  TerminalRenderer renderer;
+  Screen terminal;
+  Frame screen{};
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  for (int frame = 0; frame < 50; frame++) {
+    // a few changes per frame, including the last column
+    for (int i = 0; i < 5; i++) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      screen[seed >> 59] ^= 1ull << (seed >> 32 & 63);
+    }
+    screen[frame % HEIGHT] ^= 1;
+    std::string out;
+    renderer.render(screen, out);
+    terminal.play(out);
+    terminal.expect(screen);
+  }
+}
+
+TEST(TerminalRendererTest, SendsOnlyWhatChanged) {
+  TerminalRenderer renderer;
+  Frame screen{};
+  screen[0] = ~0ull;
+  std::string out;
+  renderer.render(screen, out);
+  out.clear();
+  renderer.render(screen, out);
+  ASSERT_EQ(out, "");
+
+  // the top and bottom pixel of cell (1, 10), then its neighbour
+  screen[2] |= 1ull << (WIDTH - 1 - 10);
+  screen[3] |= 3ull << (WIDTH - 2 - 10);
+  renderer.render(screen, out);
+  ASSERT_EQ(out, "\x1b[2;11H\xe2\x96\x88\xe2\x96\x84");
+
+  // further along the same row is a forward move
+  out.clear();
+  screen[3] |= 1ull << (WIDTH - 1 - 20);
+  renderer.render(screen, out);
+  ASSERT_EQ(out, "\x1b[8C\xe2\x96\x84");
+}
+
+TEST(TerminalRendererTest, MapsKeysLikeTheWindow) {
+  ASSERT_EQ(terminal_key('1'), 0x1);
+  ASSERT_EQ(terminal_key('4'), 0xc);
+  ASSERT_EQ(terminal_key('x'), 0x0);
+  ASSERT_EQ(terminal_key('V'), 0xf);
+  ASSERT_EQ(terminal_key('p'), -1);
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../chip/chip8.h"
+#include "../trace/trace-ring.h"
+
+namespace {
+typedef std::array<uint8_t, 16> Registers;
+
+// Records an instruction the way CHIP8::traced_execute does
+void record_instruction(TraceRing &trace, uint16_t pc, uint16_t opcode,
+                        const Registers &before, const Registers &after) {
+  uint16_t changed = 0;
+  for (int reg = 0; reg < 16; reg++) {
+    changed |= uint16_t(before[reg] != after[reg]) << reg;
+  }
+  int x = 0;
+  while (x < 15 && !(changed >> x & 1)) {
+    x++;
+  }
+  if (changed & ~(1 << x | 0x8000)) {
+    trace.record_many(pc, opcode, changed, after);
+  } else {
+    trace.record(pc, opcode, x, after[x], after[0xf], changed >> x & 1,
+                 changed >> 15 & 1);
+  }
+}
+
+std::vector<TraceRecord> decode(const std::vector<uint8_t> &dump) {
+  std::vector<TraceRecord> records;
+  std::string error;
+  EXPECT_TRUE(decode_trace(dump.data(), dump.size(), records, error)) << error;
+  return records;
+}
+
+// Records n instructions with jumps, changes to one register, to one and
+// VF, and to several, and a frame marker every 10, and returns what the
+// decoder should give
+std::vector<TraceRecord> record_some(TraceRing &trace, int n) {
+  std::vector<TraceRecord> expected;
+  Registers registers{};
+  uint16_t pc = 0x200;
+  for (int i = 0; i < n; i++) {
+    if (i % 10 == 0) {
+      trace.mark_frame(i / 10);
+      TraceRecord frame;
+      frame.is_frame = true;
+      frame.frame = i / 10;
+      expected.push_back(frame);
+    }
+    Registers before = registers;
+    TraceRecord record;
+    record.pc = pc;
+    record.opcode = uint16_t(0x6000 | i);
+    if (i % 3 == 1) {
+      registers[i % 16] += 1;
+    } else if (i % 3 == 2) {
+      registers[0xf] ^= 1;
+      registers[i % 15] += 7;
+    }
+    if (i % 25 == 24) {
+      for (int reg = 0; reg < 9; reg++) {
+        registers[reg] += 3;
+      }
+    }
+    for (int reg = 0; reg < 16; reg++) {
+      if (before[reg] != registers[reg]) {
+        record.changed |= 1 << reg;
+        record.values[reg] = registers[reg];
+      }
+    }
+    record_instruction(trace, pc, record.opcode, before, registers);
+    expected.push_back(record);
+    pc = i % 7 == 6 ? 0x200 + (i * 37) % 0xc00 : pc + 2;
+  }
+  return expected;
+}
+
+void expect_same(const TraceRecord &a, const TraceRecord &b) {
+  ASSERT_EQ(a.is_frame, b.is_frame);
+  ASSERT_EQ(a.frame, b.frame);
+  ASSERT_EQ(a.pc, b.pc);
+  ASSERT_EQ(a.opcode, b.opcode);
+  ASSERT_EQ(a.changed, b.changed);
+  ASSERT_EQ(a.values, b.values);
+}
+} // namespace
+
+TEST(TraceTest, RoundTrips) {
+  TraceRing trace;
+  std::vector<TraceRecord> expected = record_some(trace, 500);
+  std::vector<TraceRecord> decoded = decode(trace.dump());
+  ASSERT_EQ(decoded.size(), expected.size());
+  for (std::size_t i = 0; i < decoded.size(); i++) {
+    expect_same(decoded[i], expected[i]);
+  }
+}
+
+TEST(TraceTest, KeepsTheNewestRecords) {
+  TraceRing trace(64);
+  std::vector<TraceRecord> expected = record_some(trace, 5000);
+  std::vector<TraceRecord> decoded = decode(trace.dump());
+  // a word each, or three for the multi-register records
+  ASSERT_GT(decoded.size(), 50u);
+  ASSERT_LE(decoded.size(), 64u);
+  std::size_t offset = expected.size() - decoded.size();
+  for (std::size_t i = 0; i < decoded.size(); i++) {
+    expect_same(decoded[i], expected[offset + i]);
+  }
+}
+
+TEST(TraceTest, StraightLineCodeIsCompact) {
+  TraceRing trace;
+  Registers registers{};
+  for (int i = 0; i < 60; i++) {
+    record_instruction(trace, 0x200 + 2 * i, 0x00e0, registers, registers);
+  }
+  // tag and opcode each, plus the first record's PC
+  ASSERT_EQ(trace.dump().size(), TRACE_HEADER_SIZE + 60 * 3 + 2);
+}
+
+TEST(TraceTest, SplitsIntoChunks) {
+  TraceRing trace;
+  std::vector<TraceRecord> expected = record_some(trace, 2000);
+  std::vector<uint8_t> dump = trace.dump();
+  ASSERT_GT(dump.size(), TRACE_HEADER_SIZE + 4 * TRACE_CHUNK_SIZE);
+  // from the third chunk on, the decoder only needs its own bytes
+  std::vector<uint8_t> tail(dump.begin(), dump.begin() + TRACE_HEADER_SIZE);
+  tail.insert(tail.end(), dump.begin() + TRACE_HEADER_SIZE +
+                              2 * TRACE_CHUNK_SIZE,
+              dump.end());
+  std::vector<TraceRecord> decoded = decode(tail);
+  ASSERT_GT(decoded.size(), 0u);
+  std::size_t offset = expected.size() - decoded.size();
+  for (std::size_t i = 0; i < decoded.size(); i++) {
+    expect_same(decoded[i], expected[offset + i]);
+  }
+}
+
+TEST(TraceTest, FileDumpMatches) {
+  TraceRing trace(1024);
+  record_some(trace, 3000);
+  FILE *file = std::tmpfile();
+  ASSERT_TRUE(trace.dump_to_fd(fileno(file)));
+  std::vector<uint8_t> written(1 << 16);
+  std::rewind(file);
+  written.resize(std::fread(written.data(), 1, written.size(), file));
+  std::fclose(file);
+  ASSERT_EQ(written, trace.dump());
+}
+
+TEST(TraceTest, RejectsDamage) {
+  TraceRing trace;
+  record_some(trace, 50);
+  std::vector<uint8_t> dump = trace.dump();
+  std::vector<TraceRecord> records;
+  std::string error;
+  dump[0] = 'X';
+  ASSERT_FALSE(decode_trace(dump.data(), dump.size(), records, error));
+  dump[0] = 'C';
+  dump.resize(dump.size() - 1); // cut the last record short
+  ASSERT_FALSE(decode_trace(dump.data(), dump.size(), records, error));
+  ASSERT_NE(error.find("corrupt"), std::string::npos);
+}
+
+#ifdef CHIP8_TRACE
+TEST(TraceTest, RecordsWhatTheInterpreterRan) {
+  CHIP8 chip;
+  chip.seed(1);
+  ASSERT_TRUE(chip.load_rom(std::string(CHIP8_ROM_DIR) + "/pong.ch8"));
+  CHIP8 replay = chip;
+  TraceRing trace;
+  chip.trace = &trace;
+  chip.run_until(20);
+
+  std::vector<TraceRecord> records = decode(trace.dump());
+  ASSERT_EQ(records.size(), 20u * (DEFAULT_CYCLES_PER_FRAME + 1));
+  for (const TraceRecord &record : records) {
+    if (record.is_frame) {
+      if (record.frame > 0) {
+        replay.tick_timers();
+        replay.frame_number++;
+      }
+      ASSERT_EQ(record.frame, replay.frame_number);
+      continue;
+    }
+    Registers before = replay.registers;
+    ASSERT_EQ(record.pc, replay.program_counter);
+    replay.cycle();
+    ASSERT_EQ(record.opcode, replay.opcode);
+    for (int reg = 0; reg < 16; reg++) {
+      ASSERT_EQ(record.changed >> reg & 1,
+                before[reg] != replay.registers[reg]);
+    }
+  }
+}
+#endif
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "../chip/chip8.h"
+#include "../triple-buffer/triple-buffer.h"
+
+TEST(TripleBufferTest, TestReaderSeesLatestPublish) {
+  TripleBuffer<int> buffer;
+  ASSERT_FALSE(buffer.acquire());
+
+  buffer.write_buffer() = 1;
+  buffer.publish();
+  buffer.write_buffer() = 2;
+  buffer.publish();
+
+  ASSERT_TRUE(buffer.acquire());
+  ASSERT_EQ(buffer.read_buffer(), 2);
+  ASSERT_FALSE(buffer.acquire());
+  ASSERT_EQ(buffer.read_buffer(), 2);
+
+  buffer.write_buffer() = 3;
+  buffer.publish();
+  ASSERT_TRUE(buffer.acquire());
+  ASSERT_EQ(buffer.read_buffer(), 3);
+}
+
+TEST(TripleBufferTest, TestFramesAreNeverTorn) {
+  TripleBuffer<Frame> frames;
+  const uint64_t last = 20000;
+
+  std::thread writer([&] {
+    for (uint64_t n = 1; n <= last; n++) {
+      Frame &frame = frames.write_buffer();
+      for (auto &row : frame) {
+        row = n;
+      }
+      frames.publish();
+    }
+  });
+
+  uint64_t seen = 0;
+  while (seen != last) {
+    if (!frames.acquire()) {
+      continue;
+    }
+    const Frame &frame = frames.read_buffer();
+    for (auto row : frame) {
+      ASSERT_EQ(row, frame[0]);
+    }
+    ASSERT_GT(frame[0], seen);
+    seen = frame[0];
+  }
+  writer.join();
+}
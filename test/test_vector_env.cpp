@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../vector-env/vector-env.h"
+
+namespace {
+// Draws a random byte as a sprite row at (V5, 0), moving right a pixel per
+// loop while key 6 is held and left while key 4 is
+const std::vector<uint8_t> rom = {
+    0x62, 0x06, // 200: LD V2, 6
+    0x63, 0x04, // 202: LD V3, 4
+    0xa3, 0x00, // 204: LD I, 300
+    0xc0, 0xff, // 206: RND V0, FF
+    0xf0, 0x55, // 208: LD [I], V0
+    0xd5, 0x41, // 20A: DRW V5, V4, 1
+    0xe2, 0xa1, // 20C: SKNP V2
+    0x75, 0x01, // 20E: ADD V5, 1
+    0xe3, 0xa1, // 210: SKNP V3
+    0x75, 0xff, // 212: ADD V5, -1
+    0x12, 0x06, // 214: JP 206
+};
+
+std::vector<uint8_t> run(int threads, int envs, int steps) {
+  VectorEnv env(rom, envs, 2, threads, 7);
+  std::vector<uint8_t> actions(envs);
+  std::vector<uint8_t> history;
+  for (int step = 0; step < steps; step++) {
+    for (int i = 0; i < envs; i++) {
+      actions[i] = (i + step) % 3 == 0 ? 6 : NO_ACTION;
+    }
+    env.step(actions.data());
+    history.insert(history.end(), env.observations(),
+                   env.observations() + envs * HEIGHT * WIDTH);
+  }
+  return history;
+}
+} // namespace
+
+TEST(VectorEnvTest, ObservationsMatchTheScreens) {
+  VectorEnv env(rom, 5, 3, 1);
+  std::vector<uint8_t> actions(5, 6);
+  env.step(actions.data());
+  for (int i = 0; i < env.size(); i++) {
+    const CHIP8 &chip = env.env(i);
+    ASSERT_EQ(chip.frame_number, 3u);
+    ASSERT_EQ(env.program_counters()[i], chip.program_counter);
+    ASSERT_EQ(env.registers()[i * 16 + 5], chip.registers[5]);
+    for (int y = 0; y < HEIGHT; y++) {
+      ASSERT_EQ(env.screens()[i * HEIGHT + y], chip.screen[y]);
+      for (int x = 0; x < WIDTH; x++) {
+        ASSERT_EQ(env.observations()[(i * HEIGHT + y) * WIDTH + x],
+                  chip.pixel(x, y) ? 1 : 0);
+      }
+    }
+  }
+}
+
+TEST(VectorEnvTest, ThreadCountDoesNotChangeResults) {
+  std::vector<uint8_t> single = run(1, 13, 20);
+  ASSERT_EQ(run(4, 13, 20), single);
+  ASSERT_EQ(run(13, 13, 20), single);
+}
+
+TEST(VectorEnvTest, EpisodesResetFromTheSnapshot) {
+  VectorEnv env(rom, 4, 1, 2);
+  CHIP8 start = env.env(0);
+  start.registers[5] = 40;
+  env.set_reset_state(start);
+  env.set_max_episode_frames(3);
+  env.set_reward([](const CHIP8 &chip) { return float(chip.registers[5]); });
+  env.reset();
+
+  std::vector<uint8_t> actions = {6, 6, NO_ACTION, 4};
+  for (int step = 1; step <= 3; step++) {
+    env.step(actions.data());
+    for (int i = 0; i < 4; i++) {
+      ASSERT_EQ(env.dones()[i], step == 3);
+    }
+  }
+  // the rewards are from the last frame of the episode, the registers
+  // already from the next one
+  ASSERT_GT(env.rewards()[0], 40.0f);
+  ASSERT_EQ(env.rewards()[0], env.rewards()[1]);
+  ASSERT_EQ(env.rewards()[2], 40.0f);
+  ASSERT_LT(env.rewards()[3], 40.0f);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(env.registers()[i * 16 + 5], 40);
+    ASSERT_EQ(env.env(i).frame_number, 0u);
+  }
+}
+
+TEST(VectorEnvTest, DoneFunctionEndsEpisodes) {
+  VectorEnv env(rom, 2, 1, 1);
+  env.set_done([](const CHIP8 &chip) { return chip.registers[5] >= 2; });
+  std::vector<uint8_t> actions = {6, NO_ACTION};
+  env.step(actions.data());
+  ASSERT_EQ(env.dones()[0], 0);
+  env.step(actions.data());
+  ASSERT_EQ(env.dones()[0], 1);
+  ASSERT_EQ(env.dones()[1], 0);
+  ASSERT_EQ(env.registers()[5], 0);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "../chip/chip8.h"
+#include "../vip-timing/vip-timing.h"
+
+namespace {
+constexpr VipCostTable costs = make_vip_cost_table();
+static_assert(costs.cost[0x600] == 6, "6XKK");
+static_assert(costs.cost[0x8f4] == 44, "8XY4");
+static_assert(costs.cost[0xf33] == (80 | VIP_VARIABLE), "FX33");
+static_assert(costs.cost[0x0e0] == 24, "00E0");
+
+const int BUDGET = VIP_CYCLES_PER_FRAME - VIP_DISPLAY_CYCLES;
+} // namespace
+
+TEST(VipTimingTest, FramesRunTheirCycleBudget) {
+  // ADD V0, 1; JP 200: 102 cycles a loop
+  const uint8_t rom[] = {0x70, 0x01, 0x12, 0x00};
+  CHIP8 chip;
+  chip.vip_timing = true;
+  chip.load_rom(rom, sizeof(rom));
+  const int frames = 10;
+  chip.run_until(frames);
+
+  const int loop = 2 * VIP_FETCH_CYCLES + 10 + 12;
+  // each frame overruns by less than one instruction and pays it back
+  ASSERT_NEAR(chip.registers[0], frames * BUDGET / loop, 1);
+  ASSERT_LE(chip.vip_budget, 0);
+  ASSERT_GT(chip.vip_budget, -(VIP_FETCH_CYCLES + 12));
+}
+
+TEST(VipTimingTest, DrawWaitsForTheDisplayInterrupt) {
+  // ADD V0, 1; DRW V1, V1, 5; JP 200: one draw, so one add, per frame
+  const uint8_t rom[] = {0x70, 0x01, 0xd1, 0x15, 0x12, 0x00};
+  CHIP8 chip;
+  chip.vip_timing = true;
+  chip.load_rom(rom, sizeof(rom));
+  chip.run_frame();
+  ASSERT_EQ(chip.registers[0], 1);
+  ASSERT_EQ(chip.program_counter, 0x202); // waiting on the DXYN
+  ASSERT_EQ(chip.vip_budget, 0);
+  chip.run_until(8);
+  ASSERT_EQ(chip.registers[0], 8);
+}
+
+TEST(VipTimingTest, VariableCosts) {
+  // LD V1, 123; LD I, 300; LD B, V1; SE V1, 123; (skipped); JP 20A
+  const uint8_t rom[] = {0x61, 0x7b, 0xa3, 0x00, 0xf1, 0x33,
+                         0x31, 0x7b, 0x00, 0x00, 0x12, 0x0a};
+  CHIP8 chip;
+  chip.vip_timing = true;
+  chip.load_rom(rom, sizeof(rom));
+  chip.vip_budget = -BUDGET; // leaves exactly nothing to start with
+  chip.vip_budget += 6 + 12 + 80 + 6 * VIP_BCD_DIGIT_CYCLES + 10 +
+                     VIP_SKIP_CYCLES + 4 * VIP_FETCH_CYCLES;
+  chip.step_vip_frame();
+  ASSERT_EQ(chip.program_counter, 0x20a);
+  ASSERT_EQ(chip.vip_budget, 0);
+  ASSERT_EQ(chip.memory[0x300], 1);
+}
+
+TEST(VipTimingTest, OffByDefault) {
+  const uint8_t rom[] = {0x70, 0x01, 0x12, 0x00};
+  CHIP8 chip;
+  chip.load_rom(rom, sizeof(rom));
+  chip.run_frame();
+  ASSERT_EQ(chip.registers[0], (DEFAULT_CYCLES_PER_FRAME + 1) / 2);
+}
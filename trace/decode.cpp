@@ -0,0 +1,68 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "trace-ring.h"
+
+// Prints a dump written by TraceRing::dump() or dump_to_fd(), e.g. by
+// `headless --trace-dir`, one instruction per line with the registers it
+// changed:
+//   ./trace_decode --last 100 traces/pong.trace
+int main(int argc, char *argv[]) {
+  std::size_t last = 0;
+  std::string path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--last" && i + 1 < argc) {
+      last = std::strtoull(argv[++i], nullptr, 10);
+    } else if (path.empty() && arg.compare(0, 2, "--") != 0) {
+      path = arg;
+    } else {
+      path.clear();
+      break;
+    }
+  }
+  if (path.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--last <n>] <trace dump>\n";
+    return 2;
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  std::vector<TraceRecord> records;
+  std::string error;
+  if (!file.good() && !file.eof()) {
+    std::cerr << "Can't read " << path << std::endl;
+    return 1;
+  }
+  bool ok = decode_trace(data.data(), data.size(), records, error);
+
+  std::size_t first = last && last < records.size() ? records.size() - last : 0;
+  for (std::size_t i = first; i < records.size(); i++) {
+    const TraceRecord &record = records[i];
+    if (record.is_frame) {
+      std::cout << "frame " << std::dec << record.frame << '\n';
+      continue;
+    }
+    std::cout << std::hex << std::setfill('0') << "  " << std::setw(3)
+              << record.pc << "  " << std::setw(4) << record.opcode;
+    for (int reg = 0; reg < 16; reg++) {
+      if (record.changed >> reg & 1) {
+        std::cout << "  V" << std::uppercase << reg << std::nouppercase << '='
+                  << std::setw(2) << int(record.values[reg]);
+      }
+    }
+    std::cout << '\n';
+  }
+  if (!ok) {
+    // what came before the damage is still worth seeing
+    std::cerr << path << ": " << error << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,279 @@
+#include "trace-ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+
+void put_header(uint8_t *out) {
+  std::memcpy(out, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  out[4] = TRACE_VERSION;
+  for (int i = 0; i < 4; i++) {
+    out[5 + i] = uint8_t(TRACE_CHUNK_SIZE >> (8 * i));
+  }
+}
+
+bool write_all(int fd, const void *data, std::size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = ::write(fd, bytes, size);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+std::size_t put_varint(uint8_t *out, uint64_t value) {
+  std::size_t size = 0;
+  for (; value >= 0x80; value >>= 7) {
+    out[size++] = uint8_t(value) | 0x80;
+  }
+  out[size++] = uint8_t(value);
+  return size;
+}
+
+bool get_varint(const uint8_t *&in, const uint8_t *end, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; in < end && shift < 64; shift += 7) {
+    uint8_t byte = *in++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool get_bytes(const uint8_t *&in, const uint8_t *end, uint8_t *out,
+               std::size_t size) {
+  if (std::size_t(end - in) < size) {
+    return false;
+  }
+  std::memcpy(out, in, size);
+  in += size;
+  return true;
+}
+
+// One chunk, from a state where the expected PC is 0
+bool decode_chunk(const uint8_t *in, const uint8_t *end,
+                  std::vector<TraceRecord> &records) {
+  uint16_t expected_pc = 0;
+  while (in < end && *in != TRACE_PAD) {
+    TraceRecord record;
+    uint8_t tag = *in++;
+    uint8_t bytes[4];
+    if (tag == TRACE_FRAME) {
+      record.is_frame = true;
+      if (!get_varint(in, end, record.frame)) {
+        return false;
+      }
+      records.push_back(record);
+      continue;
+    }
+
+    if (tag == TRACE_MANY) {
+      if (!get_bytes(in, end, bytes, 2)) {
+        return false;
+      }
+      record.pc = bytes[0] | bytes[1] << 8;
+    } else if (tag & 0x80) {
+      return false;
+    } else {
+      record.pc = expected_pc;
+      if (tag & TRACE_PC) {
+        if (!get_bytes(in, end, bytes, 2)) {
+          return false;
+        }
+        record.pc = bytes[0] | bytes[1] << 8;
+      }
+      record.changed = (tag & TRACE_CHANGED ? 1 << (tag & 0xf) : 0) |
+                       (tag & TRACE_FLAG ? 0x8000 : 0);
+    }
+    if (!get_bytes(in, end, bytes, 2)) {
+      return false;
+    }
+    record.opcode = bytes[0] << 8 | bytes[1];
+    if (tag == TRACE_MANY) {
+      if (!get_bytes(in, end, bytes, 2)) {
+        return false;
+      }
+      record.changed = bytes[0] | bytes[1] << 8;
+    }
+    for (int i = 0; i < 16; i++) {
+      if ((record.changed >> i & 1) &&
+          !get_bytes(in, end, &record.values[i], 1)) {
+        return false;
+      }
+    }
+    expected_pc = record.pc + 2;
+    records.push_back(record);
+  }
+  return true;
+}
+
+} // namespace
+
+TraceRing::TraceRing(std::size_t capacity) : capacity(16) {
+  while (this->capacity < capacity) {
+    this->capacity *= 2;
+  }
+  words.reset(new uint64_t[this->capacity]());
+}
+
+void TraceRing::record_many(uint16_t pc, uint16_t opcode, uint16_t changed,
+                            const std::array<uint8_t, 16> &registers) {
+  put(TRACE_RAW_MANY | pc | uint64_t(opcode) << 16 | uint64_t(changed) << 32);
+  uint64_t values = 0;
+  int packed = 0;
+  for (int i = 0; i < 16; i++) {
+    if (changed >> i & 1) {
+      values |= uint64_t(registers[i]) << (8 * packed);
+      if (++packed == 7) {
+        put(TRACE_RAW_VALUES | values);
+        values = 0;
+        packed = 0;
+      }
+    }
+  }
+  if (packed > 0) {
+    put(TRACE_RAW_VALUES | values);
+  }
+}
+
+void TraceRing::clear() { end = 0; }
+
+template <typename Emit> bool TraceRing::encode(Emit emit) const {
+  // 8 bytes of slack, since instructions are stored as whole words
+  uint8_t chunk[TRACE_CHUNK_SIZE + 8];
+  std::size_t used = 0;
+  uint64_t expected = 0;
+  uint64_t at = end > capacity ? end - capacity : 0;
+  while (at < end) {
+    uint64_t raw = words[at++ & (capacity - 1)];
+    uint64_t kind = raw & ~(TRACE_RAW_FRAME - 1);
+    uint8_t out[TRACE_MAX_RECORD];
+    std::size_t size = 0;
+    if (kind == TRACE_RAW_VALUES) {
+      // what's left of a record whose start was overwritten
+      continue;
+    } else if (kind == TRACE_RAW_FRAME) {
+      out[size++] = TRACE_FRAME;
+      size += put_varint(out + size, raw & (TRACE_RAW_FRAME - 1));
+    } else if (kind == TRACE_RAW_MANY) {
+      uint16_t changed = raw >> 32 & 0xffff;
+      out[size++] = TRACE_MANY;
+      out[size++] = raw & 0xff;
+      out[size++] = raw >> 8 & 0xff;
+      out[size++] = raw >> 24 & 0xff;
+      out[size++] = raw >> 16 & 0xff;
+      out[size++] = changed & 0xff;
+      out[size++] = changed >> 8;
+      uint64_t values = 0;
+      for (int i = 0, packed = 7; i < 16; i++) {
+        if (changed >> i & 1) {
+          if (packed == 7) {
+            // record_many wrote them all, after everything still retained
+            values = words[at++ & (capacity - 1)];
+            packed = 0;
+          }
+          out[size++] = uint8_t(values >> (8 * packed++));
+        }
+      }
+    }
+    // an instruction takes at most 7 bytes
+    if (used + (size ? size : 7) > TRACE_CHUNK_SIZE) {
+      std::memset(chunk + used, TRACE_PAD, TRACE_CHUNK_SIZE - used);
+      if (!emit(chunk, TRACE_CHUNK_SIZE)) {
+        return false;
+      }
+      used = 0;
+      expected = 0;
+    }
+    if (size) {
+      std::memcpy(chunk + used, out, size);
+      used += size;
+      if (kind == TRACE_RAW_MANY) {
+        expected = (raw & 0xffff) + 2;
+      }
+      continue;
+    }
+
+    // Instructions are assembled in a word and stored whole, which may
+    // write junk past the record: it's overwritten by the next one, or
+    // isn't emitted
+    uint64_t pc = raw & 0xffff;
+    uint64_t opcode = raw >> 16 & 0xffff;
+    uint64_t reg = raw >> 32 & 0xf;
+    // when VF was the register, only VF can have changed
+    uint64_t is_flag = reg == 0xf;
+    uint64_t flag_changed = (raw >> 37 | (raw >> 36 & is_flag)) & 1;
+    uint64_t reg_changed = raw >> 36 & 1 & ~is_flag;
+    uint64_t jumped = pc != expected;
+    uint64_t tag = reg_changed << 4 | (reg & -reg_changed) |
+                   flag_changed << 5 | jumped << 6;
+    uint64_t values = (raw >> 40 & 0xff & -reg_changed) |
+                      (raw >> 48 & 0xff) << (8 * reg_changed);
+    uint64_t tail = (opcode >> 8 | (opcode & 0xff) << 8) | values << 16;
+    uint64_t word = tag | (pc & -jumped) << 8 | tail << (8 + 16 * jumped);
+    for (int i = 0; i < 8; i++) {
+      chunk[used + i] = uint8_t(word >> (8 * i));
+    }
+    used += 3 + reg_changed + flag_changed + 2 * jumped;
+    expected = pc + 2;
+  }
+  return used == 0 || emit(chunk, used);
+}
+
+std::vector<uint8_t> TraceRing::dump() const {
+  std::vector<uint8_t> out(TRACE_HEADER_SIZE);
+  put_header(out.data());
+  encode([&out](const uint8_t *chunk, std::size_t size) {
+    out.insert(out.end(), chunk, chunk + size);
+    return true;
+  });
+  return out;
+}
+
+bool TraceRing::dump_to_fd(int fd) const {
+  uint8_t header[TRACE_HEADER_SIZE];
+  put_header(header);
+  return write_all(fd, header, sizeof(header)) &&
+         encode([fd](const uint8_t *chunk, std::size_t size) {
+           return write_all(fd, chunk, size);
+         });
+}
+
+bool decode_trace(const uint8_t *data, std::size_t size,
+                  std::vector<TraceRecord> &records, std::string &error) {
+  if (size < TRACE_HEADER_SIZE ||
+      std::memcmp(data, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+    error = "not a trace dump";
+    return false;
+  }
+  if (data[4] != TRACE_VERSION) {
+    error = "unsupported trace version " + std::to_string(data[4]);
+    return false;
+  }
+  std::size_t chunk_size = 0;
+  for (int i = 0; i < 4; i++) {
+    chunk_size |= std::size_t(data[5 + i]) << (8 * i);
+  }
+  if (chunk_size == 0) {
+    error = "bad chunk size";
+    return false;
+  }
+  for (std::size_t at = TRACE_HEADER_SIZE; at < size; at += chunk_size) {
+    const uint8_t *chunk = data + at;
+    const uint8_t *end = data + std::min(size, at + chunk_size);
+    if (!decode_chunk(chunk, end, records)) {
+      error = "corrupt chunk at byte " + std::to_string(at);
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Execution history for post-mortem debugging: with CHIP8::trace set (in a
+ * build with CHIP8_TRACE), every instruction records its PC, its opcode and
+ * the registers it changed, and every frame records its number, keeping the
+ * newest records that fit.
+ *
+ * Recording only stores one raw 8-byte word, since most records are
+ * overwritten before anyone looks at them. Dumping encodes the retained
+ * words into records of variable length, typically 3 bytes:
+ *
+ *   tag          bits 0-3 a register, bit 4 that register changed, bit 5 VF
+ *                changed, bit 6 the PC isn't the last one plus 2
+ *   pc           2 bytes, little-endian, if bit 6 is set
+ *   opcode       2 bytes, big-endian
+ *   values       the changed register's new value, then VF's
+ *
+ * Instructions that change other combinations (FX65) are written as
+ * TRACE_MANY, PC, opcode, a 2-byte little-endian mask and a value per bit.
+ *
+ * A dump is cut into TRACE_CHUNK_SIZE chunks, and the decoder can start at
+ * any of them: the expected PC is 0 at every chunk start, so a chunk's
+ * first record carries its PC. A record that doesn't fit is written at the
+ * start of the next chunk, after TRACE_PAD.
+ *
+ * Like the instance it belongs to, a ring is used from one thread at a
+ * time: dump it between steps, or from a signal handler on that thread.
+ * Nothing takes a lock.
+ */
+
+const std::size_t TRACE_CHUNK_SIZE = 256;
+// In raw words, i.e. 64 KiB
+const std::size_t DEFAULT_TRACE_CAPACITY = 1 << 13;
+
+const uint8_t TRACE_CHANGED = 0x10;
+const uint8_t TRACE_FLAG = 0x20;
+const uint8_t TRACE_PC = 0x40;
+// PC, opcode, mask and values follow
+const uint8_t TRACE_MANY = 0xfd;
+// Followed by a varint frame number: that frame starts here
+const uint8_t TRACE_FRAME = 0xfe;
+// The rest of the chunk is unused
+const uint8_t TRACE_PAD = 0xff;
+
+// TRACE_MANY with all 16 registers
+const std::size_t TRACE_MAX_RECORD = 1 + 2 + 2 + 2 + 16;
+
+// A dump: "C8TR", version, chunk size (4 bytes, little-endian) and then the
+// retained chunks oldest first, the last one possibly partial
+const char TRACE_MAGIC[4] = {'C', '8', 'T', 'R'};
+const uint8_t TRACE_VERSION = 1;
+const std::size_t TRACE_HEADER_SIZE = 9;
+
+/**
+ * Raw words. The top byte is the kind; below it an instruction holds, from
+ * the bottom, PC, opcode, the register, whether it and VF changed, and
+ * their values. A frame holds its number, and TRACE_RAW_MANY the PC, the
+ * opcode and the mask of changed registers, whose values follow 7 to a
+ * TRACE_RAW_VALUES word.
+ */
+const uint64_t TRACE_RAW_FRAME = 1ull << 56;
+const uint64_t TRACE_RAW_MANY = 2ull << 56;
+const uint64_t TRACE_RAW_VALUES = 3ull << 56;
+
+class TraceRing {
+private:
+  std::size_t capacity;
+  std::unique_ptr<uint64_t[]> words;
+  // Words ever written
+  uint64_t end = 0;
+
+  inline void put(uint64_t word) { words[end++ & (capacity - 1)] = word; }
+
+  /**
+   * Encodes the retained words oldest first, passing each chunk to emit as
+   * it fills and the last, partial one at the end; stops early, returning
+   * false, if emit does.
+   */
+  template <typename Emit> bool encode(Emit emit) const;
+
+public:
+  // capacity, in words, is rounded up to a power of two of at least 16
+  explicit TraceRing(std::size_t capacity = DEFAULT_TRACE_CAPACITY);
+
+  TraceRing(const TraceRing &) = delete;
+  TraceRing &operator=(const TraceRing &) = delete;
+
+  /**
+   * One executed instruction: the PC it was fetched from, the register
+   * (other than VF) it may have changed, that register's and VF's values
+   * after it ran, and whether each changed.
+   */
+  inline void record(uint16_t pc, uint16_t opcode, int reg, uint8_t value,
+                     uint8_t flag, bool reg_changed, bool flag_changed) {
+    put(pc | uint64_t(opcode) << 16 | uint64_t(reg) << 32 |
+        uint64_t(reg_changed) << 36 | uint64_t(flag_changed) << 37 |
+        uint64_t(value) << 40 | uint64_t(flag) << 48);
+  }
+
+  // An instruction that changed any set of registers, e.g. FX65
+  void record_many(uint16_t pc, uint16_t opcode, uint16_t changed,
+                   const std::array<uint8_t, 16> &registers);
+
+  // Frame is about to run
+  inline void mark_frame(uint64_t frame) {
+    put(TRACE_RAW_FRAME | (frame & (TRACE_RAW_FRAME - 1)));
+  }
+
+  // Forgets everything recorded
+  void clear();
+
+  // The retained history as a dump (see TRACE_MAGIC)
+  std::vector<uint8_t> dump() const;
+
+  /**
+   * The same dump, written to fd using only write() and no allocation, so
+   * that a crash handler can save the history.
+   */
+  bool dump_to_fd(int fd) const;
+};
+
+struct TraceRecord {
+  // A TRACE_FRAME marker rather than an instruction
+  bool is_frame = false;
+  uint64_t frame = 0;
+  uint16_t pc = 0;
+  uint16_t opcode = 0;
+  // Registers the instruction changed, and their new values
+  uint16_t changed = 0;
+  std::array<uint8_t, 16> values{};
+};
+
+// false, with the reason in error, if data isn't a well-formed dump
+bool decode_trace(const uint8_t *data, std::size_t size,
+                  std::vector<TraceRecord> &records, std::string &error);
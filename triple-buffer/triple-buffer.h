@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "../ring-buffer/spsc-ring.h"
+
+/**
+ * Lock-free triple buffer for handing whole values from one writer thread to
+ * one reader thread. The writer fills write_buffer() and publishes it; the
+ * reader picks up the most recent published value whenever it likes. Neither
+ * side waits on the other, the reader never sees a half written value, and
+ * values are never copied by the buffer itself: publishing and acquiring
+ * only swap indices.
+ */
+template <typename T> class TripleBuffer {
+private:
+  // Set on the shared index when it holds a value the reader hasn't taken
+  static const uint8_t DIRTY = 0x4;
+  static const uint8_t INDEX_MASK = 0x3;
+
+  std::array<T, 3> buffers;
+  // The buffer that is neither being written nor read, plus the DIRTY bit
+  std::atomic<uint8_t> middle;
+  char middle_padding[CACHE_LINE_SIZE];
+  uint8_t back; // owned by the writer
+  char back_padding[CACHE_LINE_SIZE];
+  uint8_t front; // owned by the reader
+
+public:
+  TripleBuffer() : buffers(), middle(1), back(0), front(2) {}
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // Writer side
+  T &write_buffer() { return buffers[back]; }
+
+  // Writer side. Hands the write buffer to the reader and takes a free one.
+  void publish() {
+    back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) &
+           INDEX_MASK;
+  }
+
+  /**
+   * Reader side. Swaps in the latest published value if there is one.
+   * Returns false if nothing was published since the last call, in which case
+   * read_buffer() still holds the previous value.
+   */
+  bool acquire() {
+    if (!(middle.load(std::memory_order_relaxed) & DIRTY)) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+
+  // Reader side
+  const T &read_buffer() const { return buffers[front]; }
+};
@@ -0,0 +1,154 @@
+#include "vector-env.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+// A byte of pixels, MSB first, as 8 bytes of 0 or 1 in memory order
+// (little endian), so one store writes 8 observation bytes
+const std::array<uint64_t, 256> bit_expand = [] {
+  std::array<uint64_t, 256> table;
+  for (int byte = 0; byte < 256; byte++) {
+    uint64_t expanded = 0;
+    for (int i = 0; i < 8; i++) {
+      expanded |= uint64_t((byte >> (7 - i)) & 1) << (8 * i);
+    }
+    table[byte] = expanded;
+  }
+  return table;
+}();
+
+} // namespace
+
+VectorEnv::VectorEnv(const std::vector<uint8_t> &rom, int env_count,
+                     int frame_skip, int threads, uint64_t seed)
+    : frame_skip(std::max(frame_skip, 1)), max_episode_frames(0), seed(seed),
+      episodes(env_count, 0), observation_data(env_count * HEIGHT * WIDTH),
+      reward_data(env_count), done_data(env_count),
+      screen_data(env_count * HEIGHT), register_data(env_count * 16),
+      program_counter_data(env_count), generation(0), pending(0),
+      quitting(false), actions(nullptr) {
+  reset_state.load_rom(rom.data(), rom.size());
+  envs.resize(env_count);
+  reset();
+
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, std::max(env_count, 1));
+  for (int slice = 1; slice < threads; slice++) {
+    workers.emplace_back(&VectorEnv::work, this, slice);
+  }
+}
+
+VectorEnv::~VectorEnv() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  start.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void VectorEnv::reset_env(int env) {
+  envs[env] = reset_state;
+  envs[env].seed(seed ^ (uint64_t(env) << 32) ^ episodes[env]);
+  episodes[env]++;
+}
+
+void VectorEnv::export_env(int env) {
+  const CHIP8 &chip = envs[env];
+  uint8_t *observation = &observation_data[env * HEIGHT * WIDTH];
+  for (int y = 0; y < HEIGHT; y++) {
+    uint64_t row = chip.screen[y];
+    screen_data[env * HEIGHT + y] = row;
+    for (int byte = 0; byte < WIDTH / 8; byte++) {
+      uint64_t pixels = bit_expand[(row >> (56 - 8 * byte)) & 0xff];
+      std::memcpy(observation + y * WIDTH + byte * 8, &pixels, 8);
+    }
+  }
+  std::copy(chip.registers.begin(), chip.registers.end(),
+            &register_data[env * 16]);
+  program_counter_data[env] = chip.program_counter;
+}
+
+void VectorEnv::reset() {
+  for (int env = 0; env < size(); env++) {
+    reset_env(env);
+    reward_data[env] = 0;
+    done_data[env] = 0;
+    export_env(env);
+  }
+}
+
+void VectorEnv::step_range(int first, int last) {
+  for (int env = first; env < last; env++) {
+    CHIP8 &chip = envs[env];
+    chip.keypad.fill(0);
+    if (actions[env] != NO_ACTION) {
+      chip.set_key(actions[env], true);
+    }
+    for (int frame = 0; frame < frame_skip; frame++) {
+      chip.run_frame();
+    }
+
+    reward_data[env] = reward ? reward(chip) : 0;
+    bool finished = (done && done(chip)) ||
+                    (max_episode_frames &&
+                     chip.frame_number - reset_state.frame_number >=
+                         max_episode_frames);
+    done_data[env] = finished;
+    if (finished) {
+      reset_env(env);
+    }
+    export_env(env);
+  }
+}
+
+void VectorEnv::step_slice(int slice) {
+  int slices = workers.size() + 1;
+  int first = size() * slice / slices;
+  int last = size() * (slice + 1) / slices;
+  step_range(first, last);
+}
+
+void VectorEnv::work(int slice) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      start.wait(lock, [&] { return quitting || generation != seen; });
+      if (quitting) {
+        return;
+      }
+      seen = generation;
+    }
+    step_slice(slice);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending--;
+    }
+    finished.notify_one();
+  }
+}
+
+void VectorEnv::step(const uint8_t *step_actions) {
+  actions = step_actions;
+  if (workers.empty()) {
+    step_range(0, size());
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = workers.size();
+    generation++;
+  }
+  start.notify_all();
+  step_slice(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&] { return pending == 0; });
+}
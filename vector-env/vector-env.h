@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../chip/chip8.h"
+
+// An action that presses no key
+const uint8_t NO_ACTION = 0xff;
+
+/**
+ * A batch of environments for reinforcement learning, gym style: step()
+ * takes one action per environment and advances all of them, and the
+ * results come back as contiguous arrays indexed by environment, ready to
+ * wrap as tensors without copying:
+ *
+ *   observations()     uint8  [n][HEIGHT][WIDTH], 1 for a lit pixel
+ *   rewards()          float  [n]
+ *   dones()            uint8  [n]
+ *   screens()          uint64 [n][HEIGHT], packed as in Frame
+ *   registers()        uint8  [n][16]
+ *   program_counters() uint16 [n]
+ *
+ * Each action is held down for frame_skip frames. An environment that is
+ * done is reset straight away, so its observation is already the first of
+ * the next episode. Resets copy a cached snapshot (the ROM just loaded,
+ * unless set_reset_state() says otherwise) instead of reloading anything.
+ *
+ * Stepping is split across threads by environment. Reward and done
+ * functions run on those threads, so they must be safe to call
+ * concurrently for different instances.
+ */
+class VectorEnv {
+public:
+  typedef std::function<float(const CHIP8 &)> RewardFunc;
+  typedef std::function<bool(const CHIP8 &)> DoneFunc;
+
+private:
+  std::vector<CHIP8> envs;
+  CHIP8 reset_state;
+  int frame_skip;
+  uint64_t max_episode_frames; // 0 for no limit
+  uint64_t seed;
+  std::vector<uint64_t> episodes;
+  RewardFunc reward;
+  DoneFunc done;
+
+  std::vector<uint8_t> observation_data;
+  std::vector<float> reward_data;
+  std::vector<uint8_t> done_data;
+  std::vector<uint64_t> screen_data;
+  std::vector<uint8_t> register_data;
+  std::vector<uint16_t> program_counter_data;
+
+  // Workers 1..n-1 take the slices after the caller's own
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable start;
+  std::condition_variable finished;
+  uint64_t generation;
+  int pending;
+  bool quitting;
+  const uint8_t *actions;
+
+  void reset_env(int env);
+  void export_env(int env);
+  void step_range(int first, int last);
+  void step_slice(int slice);
+  void work(int slice);
+
+public:
+  /**
+   * threads = 0 uses every hardware thread. Environment i's CXKK is seeded
+   * from seed, i and its episode count, so runs are reproducible whatever
+   * the thread count.
+   */
+  VectorEnv(const std::vector<uint8_t> &rom, int env_count, int frame_skip = 4,
+            int threads = 0, uint64_t seed = 0);
+  ~VectorEnv();
+
+  VectorEnv(const VectorEnv &) = delete;
+  VectorEnv &operator=(const VectorEnv &) = delete;
+
+  void set_reward(RewardFunc func) { reward = func; }
+  void set_done(DoneFunc func) { done = func; }
+  // Ends episodes after this many frames; 0 never does
+  void set_max_episode_frames(uint64_t frames) { max_episode_frames = frames; }
+  // Future resets start from state, e.g. a game past its title screen
+  void set_reset_state(const CHIP8 &state) { reset_state = state; }
+
+  // Resets every environment
+  void reset();
+  // actions[i] is a key 0x0-0xf or NO_ACTION, one per environment
+  void step(const uint8_t *actions);
+
+  int size() const { return envs.size(); }
+  CHIP8 &env(int index) { return envs[index]; }
+
+  const uint8_t *observations() const { return observation_data.data(); }
+  const float *rewards() const { return reward_data.data(); }
+  const uint8_t *dones() const { return done_data.data(); }
+  const uint64_t *screens() const { return screen_data.data(); }
+  const uint8_t *registers() const { return register_data.data(); }
+  const uint16_t *program_counters() const {
+    return program_counter_data.data();
+  }
+};
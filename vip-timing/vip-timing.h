@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Instruction timing of the original CHIP-8 interpreter on the COSMAC VIP,
+ * in 1802 machine cycles (8 clocks at 1.7609 MHz, about 4.54 us).
+ *
+ * The costs are approximations from published disassemblies and timing
+ * measurements of the VIP interpreter, good enough for ROMs written
+ * against real hardware to run at the speed their authors saw. They are
+ * not a cycle-exact 1802 emulation.
+ */
+
+// 1760900 / 8 / 60
+const int VIP_CYCLES_PER_FRAME = 3668;
+
+// Taken from every frame by display DMA (128 scanlines of 8 bytes) and the
+// interrupt routine that runs the timers
+const int VIP_DISPLAY_CYCLES = 1024 + 48;
+
+// Fetching and decoding any instruction, before its own cost
+const int VIP_FETCH_CYCLES = 40;
+
+// Marks table entries whose cost also depends on what the instruction did
+const uint8_t VIP_VARIABLE = 0x80;
+
+// Extra cost when a conditional skip is taken
+const int VIP_SKIP_CYCLES = 4;
+
+// DXYN per sprite row, when the row lands in one display byte or two
+const int VIP_ROW_ALIGNED_CYCLES = 34;
+const int VIP_ROW_UNALIGNED_CYCLES = 58;
+
+// FX33 per unit of the digits it writes: the VIP divides by subtraction
+const int VIP_BCD_DIGIT_CYCLES = 16;
+
+// FX55/FX65 per register copied
+const int VIP_REGISTER_COPY_CYCLES = 14;
+
+/**
+ * The fixed part of an instruction's cost, possibly with VIP_VARIABLE set,
+ * from its top nibble and low byte (all that the costs depend on).
+ */
+constexpr uint8_t vip_base_cost(int nibble, int low) {
+  switch (nibble) {
+  case 0x0:
+    return low == 0xe0 ? 24 : 10;
+  case 0x1:
+    return 12;
+  case 0x2:
+    return 26;
+  case 0x3:
+  case 0x4:
+    return 10 | VIP_VARIABLE;
+  case 0x5:
+  case 0x9:
+    return 14 | VIP_VARIABLE;
+  case 0x6:
+    return 6;
+  case 0x7:
+    return 10;
+  case 0x8:
+    return 44;
+  case 0xa:
+    return 12;
+  case 0xb:
+    return 22;
+  case 0xc:
+    return 36;
+  case 0xd:
+    return 26 | VIP_VARIABLE;
+  case 0xe:
+    return 14 | VIP_VARIABLE;
+  default: // 0xf
+    switch (low) {
+    case 0x0a:
+      return 14; // per poll while it waits
+    case 0x1e:
+    case 0x29:
+      return 16;
+    case 0x33:
+      return 80 | VIP_VARIABLE;
+    case 0x55:
+    case 0x65:
+      return 14 | VIP_VARIABLE;
+    default:
+      return 10;
+    }
+  }
+}
+
+// Indexed by (opcode >> 4 & 0xf00) | (opcode & 0xff). A plain array so
+// that it can be filled in a C++14 constexpr function.
+struct VipCostTable {
+  uint8_t cost[16 * 256];
+};
+
+constexpr VipCostTable make_vip_cost_table() {
+  VipCostTable table{};
+  for (int nibble = 0; nibble < 16; nibble++) {
+    for (int low = 0; low < 256; low++) {
+      table.cost[nibble << 8 | low] = vip_base_cost(nibble, low);
+    }
+  }
+  return table;
+}